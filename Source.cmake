@@ -6,9 +6,12 @@ set(CORE_SOURCE_FILES
    "${SRC_DIR}/Core/Archive.h"
    "${SRC_DIR}/Core/Assert.h"
    "${SRC_DIR}/Core/Enum.h"
+   "${SRC_DIR}/Core/Hash.h"
    "${SRC_DIR}/Core/Log.h"
    "${SRC_DIR}/Core/Log.cpp"
    "${SRC_DIR}/Core/Math.h"
+   "${SRC_DIR}/Core/RingBuffer.h"
+   "${SRC_DIR}/Core/SPSCQueue.h"
 )
 
 set(EMULATOR_SOURCE_FILES
@@ -16,23 +19,37 @@ set(EMULATOR_SOURCE_FILES
    "${SRC_DIR}/Emulator/Emulator.cpp"
    "${SRC_DIR}/Emulator/Logo.inl"
    "${SRC_DIR}/Emulator/Main.cpp"
+   "${SRC_DIR}/Emulator/RewindBuffer.h"
+   "${SRC_DIR}/Emulator/RewindBuffer.cpp"
 )
 
 set(GAMEBOY_SOURCE_FILES
+   "${SRC_DIR}/GameBoy/AudioCapture.h"
+   "${SRC_DIR}/GameBoy/AudioCapture.cpp"
+   "${SRC_DIR}/GameBoy/BandLimitedBuffer.h"
+   "${SRC_DIR}/GameBoy/BandLimitedBuffer.cpp"
    "${SRC_DIR}/GameBoy/Cartridge.h"
    "${SRC_DIR}/GameBoy/Cartridge.cpp"
    "${SRC_DIR}/GameBoy/CPU.h"
    "${SRC_DIR}/GameBoy/CPU.cpp"
    "${SRC_DIR}/GameBoy/GameBoy.h"
    "${SRC_DIR}/GameBoy/GameBoy.cpp"
+   "${SRC_DIR}/GameBoy/GBS.h"
+   "${SRC_DIR}/GameBoy/GBS.cpp"
    "${SRC_DIR}/GameBoy/LCDController.h"
    "${SRC_DIR}/GameBoy/LCDController.cpp"
    "${SRC_DIR}/GameBoy/MemoryBankController.h"
    "${SRC_DIR}/GameBoy/MemoryBankController.cpp"
    "${SRC_DIR}/GameBoy/Operations.h"
    "${SRC_DIR}/GameBoy/Operations.cpp"
+   "${SRC_DIR}/GameBoy/Resampler.h"
+   "${SRC_DIR}/GameBoy/Resampler.cpp"
+   "${SRC_DIR}/GameBoy/RomImage.h"
+   "${SRC_DIR}/GameBoy/RomImage.cpp"
    "${SRC_DIR}/GameBoy/SoundController.h"
    "${SRC_DIR}/GameBoy/SoundController.cpp"
+   "${SRC_DIR}/GameBoy/WavFile.h"
+   "${SRC_DIR}/GameBoy/WavFile.cpp"
 )
 
 set(PLATFORM_AUDIO_SOURCE_FILES
@@ -2,6 +2,7 @@
 
 #include "Core/Assert.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <memory>
@@ -11,6 +12,67 @@
 namespace DotMatrix
 {
 
+// Read only view of serialized data owned by someone else (a file that was read into memory, a buffer handed over by a
+// frontend, an Archive, ...)
+class ArchiveView
+{
+public:
+   ArchiveView(const uint8_t* inData, std::size_t inSize)
+      : data(inData)
+      , size(inSize)
+   {
+   }
+
+   ArchiveView(const std::vector<uint8_t>& inData)
+      : ArchiveView(inData.data(), inData.size())
+   {
+   }
+
+   const uint8_t* getData() const
+   {
+      return data;
+   }
+
+   std::size_t getSize() const
+   {
+      return size;
+   }
+
+   std::size_t getOffset() const
+   {
+      return offset;
+   }
+
+   bool isAtEnd() const
+   {
+      return offset == size;
+   }
+
+   bool readBytes(void* outBytes, std::size_t numBytes)
+   {
+      if (numBytes > size - offset)
+      {
+         return false;
+      }
+
+      std::memcpy(outBytes, data + offset, numBytes);
+      offset += numBytes;
+
+      return true;
+   }
+
+   template<typename T>
+   bool read(T& outVal)
+   {
+      return readBytes(&outVal, sizeof(T));
+   }
+
+private:
+   const uint8_t* data = nullptr;
+   std::size_t size = 0;
+   std::size_t offset = 0;
+};
+
 class Archive
 {
 public:
@@ -26,17 +88,36 @@ public:
    {
    }
 
+   // Writes into memory owned by the caller, which can't grow (writes that don't fit fail, see hasOverflowed())
+   Archive(uint8_t* buffer, std::size_t capacity)
+      : externalData(buffer)
+      , externalCapacity(capacity)
+   {
+   }
+
    Archive(const Archive& other)
       : data(other.data)
+      , externalData(other.externalData)
+      , externalCapacity(other.externalCapacity)
+      , externalSize(other.externalSize)
       , offset(other.offset)
+      , overflowed(other.overflowed)
    {
    }
 
    Archive(Archive&& other)
       : data(std::move(other.data))
+      , externalData(other.externalData)
+      , externalCapacity(other.externalCapacity)
+      , externalSize(other.externalSize)
       , offset(std::move(other.offset))
+      , overflowed(other.overflowed)
    {
+      other.externalData = nullptr;
+      other.externalCapacity = 0;
+      other.externalSize = 0;
       other.offset = 0;
+      other.overflowed = false;
    }
 
    ~Archive()
@@ -47,7 +128,11 @@ public:
    Archive& operator=(const Archive& other)
    {
       data = other.data;
+      externalData = other.externalData;
+      externalCapacity = other.externalCapacity;
+      externalSize = other.externalSize;
       offset = other.offset;
+      overflowed = other.overflowed;
 
       return *this;
    }
@@ -55,58 +140,144 @@ public:
    Archive& operator=(Archive&& other)
    {
       data = std::move(other.data);
+      externalData = other.externalData;
+      externalCapacity = other.externalCapacity;
+      externalSize = other.externalSize;
       offset = std::move(other.offset);
+      overflowed = other.overflowed;
+
+      other.externalData = nullptr;
+      other.externalCapacity = 0;
+      other.externalSize = 0;
       other.offset = 0;
+      other.overflowed = false;
 
       return *this;
    }
 
+   // Only for archives that own their data
    const std::vector<uint8_t>& getData() const
    {
+      DM_ASSERT(!externalData);
       return data;
    }
 
+   const uint8_t* getBytes() const
+   {
+      return externalData ? externalData : data.data();
+   }
+
+   std::size_t getSize() const
+   {
+      return externalData ? externalSize : data.size();
+   }
+
+   ArchiveView view() const
+   {
+      return ArchiveView(getBytes(), getSize());
+   }
+
    bool isAtEnd() const
    {
-      return offset == data.size();
+      return offset == getSize();
+   }
+
+   // Whether a write didn't fit in the caller's buffer (everything written after that fails as well)
+   bool hasOverflowed() const
+   {
+      return overflowed;
    }
 
+   // Makes room for the given number of bytes without writing anything (which saves reallocating as the data grows)
    void reserve(std::size_t numBytes)
    {
-      data.resize(numBytes);
+      if (!externalData)
+      {
+         data.reserve(numBytes);
+      }
    }
 
-   template<typename T>
-   bool read(T& outVal)
+   // Starts over, keeping the memory that was allocated
+   void clear()
+   {
+      data.clear();
+      externalSize = 0;
+      offset = 0;
+      overflowed = false;
+   }
+
+   bool readBytes(void* outBytes, std::size_t numBytes)
    {
-      std::size_t numBytes = sizeof(T);
-      if (offset + numBytes > data.size())
+      if (numBytes > getSize() - offset)
       {
          return false;
       }
 
-      std::memcpy(&outVal, &data[offset], numBytes);
+      std::memcpy(outBytes, getBytes() + offset, numBytes);
       offset += numBytes;
 
       return true;
    }
 
-   template<typename T>
-   void write(const T& inVal)
+   bool writeBytes(const void* inBytes, std::size_t numBytes)
    {
-      std::size_t numBytes = sizeof(T);
-      if (offset + numBytes > data.size())
+      std::size_t end = offset + numBytes;
+      if (end > getSize() && !grow(end))
       {
-         data.resize(offset + numBytes);
+         return false;
       }
 
-      std::memcpy(&data[offset], &inVal, numBytes);
-      offset += numBytes;
+      std::memcpy((externalData ? externalData : data.data()) + offset, inBytes, numBytes);
+      offset = end;
+
+      return true;
+   }
+
+   template<typename T>
+   bool read(T& outVal)
+   {
+      return readBytes(&outVal, sizeof(T));
+   }
+
+   template<typename T>
+   bool write(const T& inVal)
+   {
+      return writeBytes(&inVal, sizeof(T));
    }
 
 private:
+   bool grow(std::size_t numBytes)
+   {
+      if (externalData)
+      {
+         if (overflowed || numBytes > externalCapacity)
+         {
+            overflowed = true;
+            return false;
+         }
+
+         externalSize = numBytes;
+         return true;
+      }
+
+      // Grow geometrically, so that a long run of small writes only reallocates a handful of times
+      if (numBytes > data.capacity())
+      {
+         data.reserve(std::max(numBytes, data.capacity() * 2));
+      }
+      data.resize(numBytes);
+
+      return true;
+   }
+
    std::vector<uint8_t> data;
+
+   uint8_t* externalData = nullptr;
+   std::size_t externalCapacity = 0;
+   std::size_t externalSize = 0;
+
    std::size_t offset = 0;
+   bool overflowed = false;
 };
 
 } // namespace DotMatrix
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "Core/Assert.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace DotMatrix
+{
+
+// Fast non-cryptographic 64 bit hash (XXH64), fed a piece at a time like an Archive. Data is consumed in 32 byte stripes
+// over four independent lanes, which keeps the multipliers busy (and lets the compiler vectorize it).
+class Hasher
+{
+public:
+   Hasher(uint64_t seed = 0)
+      : lanes({ seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1 })
+      , initialSeed(seed)
+   {
+   }
+
+   void writeBytes(const void* inBytes, std::size_t numBytes)
+   {
+      const uint8_t* bytes = static_cast<const uint8_t*>(inBytes);
+      totalSize += numBytes;
+
+      if (bufferSize > 0)
+      {
+         std::size_t numToBuffer = std::min(numBytes, buffer.size() - bufferSize);
+         std::memcpy(buffer.data() + bufferSize, bytes, numToBuffer);
+         bufferSize += numToBuffer;
+         bytes += numToBuffer;
+         numBytes -= numToBuffer;
+
+         if (bufferSize < buffer.size())
+         {
+            return;
+         }
+
+         consumeStripe(buffer.data());
+         bufferSize = 0;
+      }
+
+      while (numBytes >= kStripeSize)
+      {
+         consumeStripe(bytes);
+         bytes += kStripeSize;
+         numBytes -= kStripeSize;
+      }
+
+      std::memcpy(buffer.data(), bytes, numBytes);
+      bufferSize = numBytes;
+   }
+
+   template<typename T>
+   void write(const T& inVal)
+   {
+      DM_STATIC_ASSERT(std::is_trivially_copyable_v<T>, "Only plain data can be hashed!");
+      writeBytes(&inVal, sizeof(T));
+   }
+
+   uint64_t finish() const
+   {
+      uint64_t hash = 0;
+      if (totalSize >= kStripeSize)
+      {
+         hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+         for (uint64_t lane : lanes)
+         {
+            hash = (hash ^ round(0, lane)) * kPrime1 + kPrime4;
+         }
+      }
+      else
+      {
+         hash = initialSeed + kPrime5;
+      }
+
+      hash += totalSize;
+
+      const uint8_t* bytes = buffer.data();
+      std::size_t numBytes = bufferSize;
+      for (; numBytes >= 8; bytes += 8, numBytes -= 8)
+      {
+         hash ^= round(0, readWord<uint64_t>(bytes));
+         hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+      }
+      if (numBytes >= 4)
+      {
+         hash ^= readWord<uint32_t>(bytes) * kPrime1;
+         hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+         bytes += 4;
+         numBytes -= 4;
+      }
+      for (; numBytes > 0; ++bytes, --numBytes)
+      {
+         hash ^= *bytes * kPrime5;
+         hash = rotateLeft(hash, 11) * kPrime1;
+      }
+
+      hash ^= hash >> 33;
+      hash *= kPrime2;
+      hash ^= hash >> 29;
+      hash *= kPrime3;
+      hash ^= hash >> 32;
+
+      return hash;
+   }
+
+private:
+   static const uint64_t kPrime1 = 0x9E3779B185EBCA87;
+   static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4F;
+   static const uint64_t kPrime3 = 0x165667B19E3779F9;
+   static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63;
+   static const uint64_t kPrime5 = 0x27D4EB2F165667C5;
+
+   static const std::size_t kStripeSize = 32;
+
+   static uint64_t rotateLeft(uint64_t value, int numBits)
+   {
+      return (value << numBits) | (value >> (64 - numBits));
+   }
+
+   static uint64_t round(uint64_t lane, uint64_t input)
+   {
+      return rotateLeft(lane + input * kPrime2, 31) * kPrime1;
+   }
+
+   // Words are always read as little endian, so that the same bytes hash the same on every platform
+   template<typename T>
+   static uint64_t readWord(const uint8_t* bytes)
+   {
+      T word = 0;
+      std::memcpy(&word, bytes, sizeof(T));
+
+#if DM_IS_BIG_ENDIAN
+      T swapped = 0;
+      for (std::size_t i = 0; i < sizeof(T); ++i)
+      {
+         swapped = (swapped << 8) | ((word >> (i * 8)) & 0xFF);
+      }
+      word = swapped;
+#endif // DM_IS_BIG_ENDIAN
+
+      return word;
+   }
+
+   void consumeStripe(const uint8_t* bytes)
+   {
+      for (std::size_t i = 0; i < lanes.size(); ++i)
+      {
+         lanes[i] = round(lanes[i], readWord<uint64_t>(bytes + i * sizeof(uint64_t)));
+      }
+   }
+
+   std::array<uint64_t, 4> lanes;
+   std::array<uint8_t, kStripeSize> buffer = {};
+   std::size_t bufferSize = 0;
+   uint64_t totalSize = 0;
+   uint64_t initialSeed = 0;
+};
+
+inline uint64_t hashBytes(const void* bytes, std::size_t numBytes, uint64_t seed = 0)
+{
+   Hasher hasher(seed);
+   hasher.writeBytes(bytes, numBytes);
+   return hasher.finish();
+}
+
+// Hash of a block of memory that keeps the hash of each page, so that hashing it again only has to look at the pages
+// written since the last time. Every write has to be reported with markDirty() (or markAllDirty(), when the whole block
+// is replaced).
+template<std::size_t kNumBytes, std::size_t kPageSize = 0x100>
+class PagedHash
+{
+public:
+   PagedHash()
+   {
+      markAllDirty();
+   }
+
+   void markDirty(std::size_t offset)
+   {
+      DM_ASSERT(offset < kNumBytes);
+      dirtyPages[offset / kPageSize] = true;
+   }
+
+   void markAllDirty()
+   {
+      dirtyPages.fill(true);
+   }
+
+   uint64_t hash(const uint8_t* data)
+   {
+      bool anyDirty = false;
+      for (std::size_t i = 0; i < kNumPages; ++i)
+      {
+         if (dirtyPages[i])
+         {
+            pageHashes[i] = hashBytes(data + i * kPageSize, kPageSize);
+            dirtyPages[i] = false;
+            anyDirty = true;
+         }
+      }
+
+      if (anyDirty)
+      {
+         blockHash = hashBytes(pageHashes.data(), sizeof(pageHashes));
+      }
+
+      return blockHash;
+   }
+
+private:
+   DM_STATIC_ASSERT(kNumBytes % kPageSize == 0, "Memory must be a whole number of pages!");
+
+   static const std::size_t kNumPages = kNumBytes / kPageSize;
+
+   std::array<uint64_t, kNumPages> pageHashes = {};
+   std::array<bool, kNumPages> dirtyPages = {};
+   uint64_t blockHash = 0;
+};
+
+} // namespace DotMatrix
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace DotMatrix
+{
+
+// Fixed capacity buffer that always accepts new values, overwriting the oldest ones once it is full
+//
+// Readers keep their own read index, so any number of them can consume the same data at their own pace (a reader that
+// falls more than a capacity's worth behind skips ahead to the oldest value still in the buffer).
+template<typename T>
+class RingBuffer
+{
+public:
+   // Capacity is rounded up to the next power of two
+   RingBuffer(std::size_t minCapacity)
+   {
+      std::size_t capacity = 1;
+      while (capacity < minCapacity)
+      {
+         capacity <<= 1;
+      }
+
+      values = std::make_unique<T[]>(capacity);
+      mask = capacity - 1;
+   }
+
+   std::size_t capacity() const
+   {
+      return mask + 1;
+   }
+
+   // Total number of values ever pushed
+   uint64_t getWriteIndex() const
+   {
+      return writeIndex;
+   }
+
+   void push(const T& value)
+   {
+      values[writeIndex & mask] = value;
+      ++writeIndex;
+   }
+
+   void write(const T* writeValues, std::size_t numValues)
+   {
+      while (numValues > 0)
+      {
+         // The write space ends where the buffer wraps around, so this takes two passes when writing across the end
+         std::size_t space = 0;
+         T* destination = getWriteSpace(space);
+         std::size_t numToWrite = std::min(numValues, space);
+
+         std::copy(writeValues, writeValues + numToWrite, destination);
+         commit(numToWrite);
+
+         writeValues += numToWrite;
+         numValues -= numToWrite;
+      }
+   }
+
+   // Space that can be written to directly (up to where the buffer wraps around), to be followed by commit()
+   T* getWriteSpace(std::size_t& numValues)
+   {
+      std::size_t offset = writeIndex & mask;
+      numValues = capacity() - offset;
+
+      return &values[offset];
+   }
+
+   void commit(std::size_t numValues)
+   {
+      writeIndex += numValues;
+   }
+
+   std::size_t available(uint64_t readIndex) const
+   {
+      return static_cast<std::size_t>(writeIndex - clampReadIndex(readIndex));
+   }
+
+   // Copies up to maxValues values starting at readIndex, advances readIndex past them, and returns the number copied
+   std::size_t read(uint64_t& readIndex, T* readValues, std::size_t maxValues) const
+   {
+      readIndex = clampReadIndex(readIndex);
+
+      std::size_t numValues = std::min(maxValues, static_cast<std::size_t>(writeIndex - readIndex));
+      std::size_t offset = readIndex & mask;
+      std::size_t numBeforeWrap = std::min(numValues, capacity() - offset);
+
+      std::copy(&values[offset], &values[offset] + numBeforeWrap, readValues);
+      std::copy(&values[0], &values[0] + (numValues - numBeforeWrap), readValues + numBeforeWrap);
+      readIndex += numValues;
+
+      return numValues;
+   }
+
+private:
+   uint64_t clampReadIndex(uint64_t readIndex) const
+   {
+      // Reading from the future (the buffer was replaced) or from data that has already been overwritten
+      if (readIndex > writeIndex)
+      {
+         return writeIndex;
+      }
+      if (writeIndex - readIndex > capacity())
+      {
+         return writeIndex - capacity();
+      }
+
+      return readIndex;
+   }
+
+   std::unique_ptr<T[]> values;
+   std::size_t mask = 0;
+   uint64_t writeIndex = 0;
+};
+
+} // namespace DotMatrix
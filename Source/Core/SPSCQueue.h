@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace DotMatrix
+{
+
+// Fixed capacity, lock-free queue that is safe to use from exactly one producer thread and one consumer thread
+template<typename T>
+class SPSCQueue
+{
+public:
+   // Capacity is rounded up to the next power of two
+   SPSCQueue(std::size_t minCapacity)
+   {
+      std::size_t capacity = 1;
+      while (capacity < minCapacity)
+      {
+         capacity <<= 1;
+      }
+
+      items = std::make_unique<T[]>(capacity);
+      mask = capacity - 1;
+   }
+
+   SPSCQueue(const SPSCQueue& other) = delete;
+   SPSCQueue& operator=(const SPSCQueue& other) = delete;
+
+   std::size_t capacity() const
+   {
+      return mask + 1;
+   }
+
+   // Producer only
+   bool tryPush(const T& item)
+   {
+      std::size_t tail = tailIndex.load(std::memory_order_relaxed);
+      if (tail - cachedHeadIndex == capacity())
+      {
+         cachedHeadIndex = headIndex.load(std::memory_order_acquire);
+         if (tail - cachedHeadIndex == capacity())
+         {
+            return false;
+         }
+      }
+
+      items[tail & mask] = item;
+      tailIndex.store(tail + 1, std::memory_order_release);
+
+      return true;
+   }
+
+   // Producer only, pushes as many items as there is space for and returns the number pushed
+   std::size_t tryPush(const T* pushItems, std::size_t count)
+   {
+      std::size_t tail = tailIndex.load(std::memory_order_relaxed);
+      std::size_t space = capacity() - (tail - cachedHeadIndex);
+      if (space < count)
+      {
+         cachedHeadIndex = headIndex.load(std::memory_order_acquire);
+         space = capacity() - (tail - cachedHeadIndex);
+      }
+
+      std::size_t numToPush = count < space ? count : space;
+      for (std::size_t i = 0; i < numToPush; ++i)
+      {
+         items[(tail + i) & mask] = pushItems[i];
+      }
+      tailIndex.store(tail + numToPush, std::memory_order_release);
+
+      return numToPush;
+   }
+
+   // Consumer only
+   bool tryPop(T& item)
+   {
+      std::size_t head = headIndex.load(std::memory_order_relaxed);
+      if (head == cachedTailIndex)
+      {
+         cachedTailIndex = tailIndex.load(std::memory_order_acquire);
+         if (head == cachedTailIndex)
+         {
+            return false;
+         }
+      }
+
+      item = items[head & mask];
+      headIndex.store(head + 1, std::memory_order_release);
+
+      return true;
+   }
+
+   // Consumer only, pops up to count items and returns the number popped
+   std::size_t tryPop(T* popItems, std::size_t count)
+   {
+      std::size_t head = headIndex.load(std::memory_order_relaxed);
+      std::size_t available = cachedTailIndex - head;
+      if (available < count)
+      {
+         cachedTailIndex = tailIndex.load(std::memory_order_acquire);
+         available = cachedTailIndex - head;
+      }
+
+      std::size_t numToPop = count < available ? count : available;
+      for (std::size_t i = 0; i < numToPop; ++i)
+      {
+         popItems[i] = items[(head + i) & mask];
+      }
+      headIndex.store(head + numToPop, std::memory_order_release);
+
+      return numToPop;
+   }
+
+   // Only exact when called from the producer or consumer while the other side is idle
+   std::size_t size() const
+   {
+      return tailIndex.load(std::memory_order_acquire) - headIndex.load(std::memory_order_acquire);
+   }
+
+   bool empty() const
+   {
+      return size() == 0;
+   }
+
+private:
+   static const std::size_t kCacheLineSize = 64;
+
+   std::unique_ptr<T[]> items;
+   std::size_t mask = 0;
+
+   // Keep each side's index (and its cached copy of the other side's index) on its own cache line
+   alignas(kCacheLineSize) std::atomic<std::size_t> headIndex = 0;
+   std::size_t cachedTailIndex = 0;
+
+   alignas(kCacheLineSize) std::atomic<std::size_t> tailIndex = 0;
+   std::size_t cachedHeadIndex = 0;
+};
+
+} // namespace DotMatrix
@@ -39,6 +39,13 @@ namespace
 {
    #include "Logo.inl"
 
+   // Snapshots leave out the framebuffers, so even games that scroll every frame only change a few hundred bytes of state
+   // per frame (enough for over ten minutes of history)
+   const std::size_t kRewindBufferSize = 16 * 1024 * 1024;
+   const uint32_t kFramesPerRewindSnapshot = 1;
+
+   const double kFrameTime = 70224.0 / DotMatrix::CPU::kClockSpeed;
+
    const DotMatrix::Framebuffer& getLogoFramebuffer()
    {
       static DotMatrix::Framebuffer logoFramebuffer;
@@ -229,6 +236,7 @@ namespace
 
 Emulator::Emulator()
    : pixels(std::make_unique<PixelArray>(PixelArray{}))
+   , rewindBuffer(kRewindBufferSize)
 {
 }
 
@@ -347,13 +355,47 @@ void Emulator::tick(double dt)
    dt *= timeScale;
 #endif // DM_WITH_UI
 
-   if (gameBoy)
+#if DM_WITH_AUDIO
+   if (audioManager.isValid())
+   {
+      // Nudge the emulation speed (by an inaudible amount) to keep the audio queue at its target, so that drift between
+      // the emulated clock and the audio device is absorbed without underruns or overruns
+      static const double kMaxRateAdjustment = 0.005;
+      dt *= 1.0 + kMaxRateAdjustment * (1.0 - 2.0 * audioManager.getFillLevel());
+   }
+#endif // DM_WITH_AUDIO
+
+   if (gameBoy && rewinding && gameBoy->hasProgram())
+   {
+      rewind();
+      cartWroteToRamLastFrame = false;
+   }
+   else if (gameBoy)
    {
       DotMatrix::Joypad joypad = DotMatrix::Joypad::unionOf(keyboardInputDevice.poll(), controllerInputDevice.poll());
       gameBoy->setJoypadState(joypad);
 
       gameBoy->tick(dt);
 
+      if (gameBoy->hasProgram())
+      {
+         captureRewindSnapshot();
+      }
+
+#if DM_WITH_AUDIO
+      // Hand everything generated over to the audio thread right away, instead of waiting for a buffer to free up
+      DotMatrix::SoundController& soundController = gameBoy->getSoundController();
+
+      // Only allocates the first time (or when the sound controller's buffer grows)
+      audioData.resize(soundController.getAudioBufferCapacity());
+      std::size_t numSamples = soundController.readAudioData(audioData.data(), audioData.size());
+
+      if (numSamples > 0)
+      {
+         audioManager.write(audioData.data(), numSamples);
+      }
+#endif // DM_WITH_AUDIO
+
       bool cartWroteToRamThisFrame = gameBoy->cartWroteToRamThisFrame();
       if (!cartWroteToRamThisFrame && cartWroteToRamLastFrame)
       {
@@ -388,18 +430,6 @@ void Emulator::render()
          ui->render(*this);
       }
 #endif // DM_WITH_UI
-
-#if DM_WITH_AUDIO
-      if (gameBoy && audioManager.canQueue())
-      {
-         const std::vector<DotMatrix::AudioSample>& audioData = gameBoy->getSoundController().swapAudioBuffers();
-
-         if (!audioData.empty())
-         {
-            audioManager.queue(audioData);
-         }
-      }
-#endif // DM_WITH_AUDIO
    }
 
    glfwSwapBuffers(window);
@@ -464,6 +494,12 @@ void Emulator::onKeyChanged(int key, int scancode, int action, int mods)
 {
    bool enabled = action == GLFW_PRESS;
 
+   if (key == GLFW_KEY_BACKSPACE)
+   {
+      // Rewinds for as long as the key is held
+      rewinding = action != GLFW_RELEASE;
+   }
+
    if (enabled)
    {
       if (key == GLFW_KEY_F11 || (key == GLFW_KEY_ENTER && ((mods & GLFW_MOD_ALT) != 0)))
@@ -475,6 +511,12 @@ void Emulator::onKeyChanged(int key, int scancode, int action, int mods)
       {
          renderUi = !renderUi;
 
+         // The sound controller window only generates channel data while it is drawn
+         if (!renderUi && gameBoy)
+         {
+            gameBoy->getSoundController().setGenerateChannelData(false);
+         }
+
          // Hide the cursor if we're in full screen with no UI
          if (!renderUi && glfwGetWindowMonitor(window) != nullptr)
          {
@@ -505,13 +547,18 @@ void Emulator::resetGameBoy(std::unique_ptr<DotMatrix::Cartridge> cartridge)
 
    gameBoy->setCartridge(std::move(cartridge));
 
+   rewindBuffer.clear();
+   framesUntilRewindSnapshot = 0;
+
 #if DM_WITH_AUDIO
    // Don't generate audio data if the audio manager isn't valid
    const bool generateAudioData = audioManager.isValid();
+   gameBoy->getSoundController().setOutputSampleRate(audioManager.getSampleRate());
 #else
    const bool generateAudioData = false;
 #endif
    gameBoy->getSoundController().setGenerateAudioData(generateAudioData);
+   gameBoy->getSoundController().setSynthesisMode(DotMatrix::SynthesisMode::BandLimited);
 
 #if DM_WITH_UI
    // Render once before ticking (to make sure we hit any initial breakpoints)
@@ -557,6 +604,60 @@ void Emulator::toggleFullScreen()
    }
 }
 
+void Emulator::captureRewindSnapshot()
+{
+   DM_ASSERT(gameBoy);
+
+   if (framesUntilRewindSnapshot > 0)
+   {
+      --framesUntilRewindSnapshot;
+      return;
+   }
+   framesUntilRewindSnapshot = kFramesPerRewindSnapshot - 1;
+
+   // Reuses the archive's memory from the last snapshot
+   rewindSnapshot.clear();
+   gameBoy->saveMachineState(rewindSnapshot);
+   rewindBuffer.push(rewindSnapshot.getData());
+}
+
+void Emulator::rewind()
+{
+   DM_ASSERT(gameBoy);
+
+   // Steps back one snapshot per frame, holding on the oldest one once the history runs out
+   if (rewindBuffer.stepBack())
+   {
+      // Snapshots don't hold the framebuffers, so run from the snapshot until a whole frame has been drawn (the one it was
+      // taken in is only partly drawn) to have something to show for it, then go back to it
+      ArchiveView state(rewindBuffer.getCurrent());
+      bool loaded = gameBoy->loadMachineState(state);
+      if (loaded)
+      {
+         gameBoy->tick(2.0 * kFrameTime);
+
+         ArchiveView stateAgain(rewindBuffer.getCurrent());
+         loaded = gameBoy->loadMachineState(stateAgain);
+      }
+
+      if (!loaded)
+      {
+         DM_LOG_WARNING("Failed to load rewind snapshot");
+         rewindBuffer.clear();
+      }
+   }
+
+   // Snapshots carry on from the restored state once rewinding stops
+   framesUntilRewindSnapshot = kFramesPerRewindSnapshot - 1;
+
+#if DM_WITH_AUDIO
+   // Audio left over from before the snapshot was loaded doesn't belong to the restored state (rewinding is silent)
+   DotMatrix::SoundController& soundController = gameBoy->getSoundController();
+   audioData.resize(soundController.getAudioBufferCapacity());
+   soundController.readAudioData(audioData.data(), audioData.size());
+#endif // DM_WITH_AUDIO
+}
+
 void Emulator::loadGame()
 {
    DM_ASSERT(gameBoy);
@@ -565,7 +666,7 @@ void Emulator::loadGame()
    {
       if (std::optional<std::vector<uint8_t>> cartRamData = IOUtils::readBinaryFile(*saveFilePath))
       {
-         Archive cartRam(std::move(*cartRamData));
+         ArchiveView cartRam(*cartRamData);
 
          if (gameBoy->loadCartRAM(cartRam))
          {
@@ -2,6 +2,8 @@
 
 #include "Core/Archive.h"
 
+#include "Emulator/RewindBuffer.h"
+
 #include "GameBoy/LCDController.h"
 
 #if DM_WITH_AUDIO
@@ -87,6 +89,8 @@ public:
 private:
    void resetGameBoy(std::unique_ptr<DotMatrix::Cartridge> cartridge);
    void toggleFullScreen();
+   void captureRewindSnapshot();
+   void rewind();
    void loadGame();
    void saveGameAsync();
    void saveThreadMain();
@@ -96,6 +100,7 @@ private:
    std::unique_ptr<Renderer> renderer;
 #if DM_WITH_AUDIO
    AudioManager audioManager;
+   std::vector<DotMatrix::AudioSample> audioData;
 #endif // DM_WITH_AUDIO
 
    std::unique_ptr<PixelArray> pixels;
@@ -116,6 +121,11 @@ private:
 
    bool cartWroteToRamLastFrame = false;
 
+   RewindBuffer rewindBuffer;
+   Archive rewindSnapshot;
+   uint32_t framesUntilRewindSnapshot = 0;
+   bool rewinding = false;
+
    std::thread saveThread;
    std::mutex saveThreadMutex;
    std::condition_variable saveThreadConditionVariable;
@@ -0,0 +1,226 @@
+#include "Core/Assert.h"
+
+#include "Emulator/RewindBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace DotMatrix
+{
+
+namespace
+{
+   // Changed bytes separated by fewer unchanged bytes than this are stored as one literal run (splitting them up would
+   // cost more in run lengths than it saves)
+   const std::size_t kMinZeroRun = 8;
+
+   void writeLength(std::vector<uint8_t>& out, std::size_t length)
+   {
+      // 7 bits at a time, with the top bit set on every byte but the last
+      while (length >= 0x80)
+      {
+         out.push_back(static_cast<uint8_t>(length | 0x80));
+         length >>= 7;
+      }
+
+      out.push_back(static_cast<uint8_t>(length));
+   }
+
+   std::size_t readLength(const uint8_t*& in)
+   {
+      std::size_t length = 0;
+      std::size_t shift = 0;
+
+      uint8_t byte = 0;
+      do
+      {
+         byte = *in++;
+         length |= static_cast<std::size_t>(byte & 0x7F) << shift;
+         shift += 7;
+      } while ((byte & 0x80) != 0x00);
+
+      return length;
+   }
+
+   bool wordsMatch(const uint8_t* first, const uint8_t* second)
+   {
+      uint64_t firstWord = 0;
+      uint64_t secondWord = 0;
+      std::memcpy(&firstWord, first, sizeof(firstWord));
+      std::memcpy(&secondWord, second, sizeof(secondWord));
+
+      return firstWord == secondWord;
+   }
+}
+
+RewindBuffer::RewindBuffer(std::size_t capacityBytes)
+   : storage(capacityBytes)
+{
+}
+
+void RewindBuffer::clear()
+{
+   entries.clear();
+   writeOffset = 0;
+   numBytesUsed = 0;
+   current.clear();
+}
+
+void RewindBuffer::push(const std::vector<uint8_t>& snapshot)
+{
+   if (snapshot.size() != current.size())
+   {
+      clear();
+      current = snapshot;
+      return;
+   }
+
+   encodeDelta(snapshot);
+
+   if (delta.size() > storage.size())
+   {
+      // Wouldn't fit even with everything else gone, so the history can't reach past this snapshot
+      clear();
+   }
+   else
+   {
+      std::size_t offset = makeRoom(delta.size());
+      std::copy(delta.begin(), delta.end(), storage.begin() + offset);
+
+      Entry entry;
+      entry.offset = offset;
+      entry.size = delta.size();
+      entries.push_back(entry);
+
+      writeOffset = offset + delta.size();
+      numBytesUsed += delta.size();
+   }
+
+   current = snapshot;
+}
+
+bool RewindBuffer::stepBack()
+{
+   if (entries.empty())
+   {
+      return false;
+   }
+
+   Entry entry = entries.back();
+   entries.pop_back();
+
+   applyDelta(entry);
+
+   numBytesUsed -= entry.size;
+   writeOffset = entries.empty() ? 0 : entries.back().offset + entries.back().size;
+
+   return true;
+}
+
+// Runs of (unchanged byte count, changed byte count, changed bytes XORed with the current snapshot), up to the last change
+void RewindBuffer::encodeDelta(const std::vector<uint8_t>& snapshot)
+{
+   DM_ASSERT(snapshot.size() == current.size());
+
+   const uint8_t* newBytes = snapshot.data();
+   const uint8_t* oldBytes = current.data();
+   const std::size_t size = snapshot.size();
+
+   delta.clear();
+
+   std::size_t i = 0;
+   while (i < size)
+   {
+      std::size_t zeroRunStart = i;
+      while (i + sizeof(uint64_t) <= size && wordsMatch(newBytes + i, oldBytes + i))
+      {
+         i += sizeof(uint64_t);
+      }
+      while (i < size && newBytes[i] == oldBytes[i])
+      {
+         ++i;
+      }
+
+      if (i == size)
+      {
+         break;
+      }
+
+      std::size_t literalStart = i;
+      std::size_t numUnchanged = 0;
+      while (i < size && numUnchanged < kMinZeroRun)
+      {
+         numUnchanged = newBytes[i] == oldBytes[i] ? numUnchanged + 1 : 0;
+         ++i;
+      }
+
+      // Unchanged bytes at the end of the literal run start the next zero run instead
+      i -= numUnchanged;
+
+      writeLength(delta, literalStart - zeroRunStart);
+      writeLength(delta, i - literalStart);
+      for (std::size_t j = literalStart; j < i; ++j)
+      {
+         delta.push_back(newBytes[j] ^ oldBytes[j]);
+      }
+   }
+
+   if (delta.empty())
+   {
+      // Identical snapshots still get an (empty) run, since entries in the ring are told apart by where they start
+      writeLength(delta, 0);
+      writeLength(delta, 0);
+   }
+}
+
+void RewindBuffer::applyDelta(const Entry& entry)
+{
+   const uint8_t* in = storage.data() + entry.offset;
+   const uint8_t* end = in + entry.size;
+
+   std::size_t i = 0;
+   while (in < end)
+   {
+      i += readLength(in);
+      std::size_t numLiterals = readLength(in);
+
+      DM_ASSERT(i + numLiterals <= current.size() && in + numLiterals <= end);
+      for (std::size_t j = 0; j < numLiterals; ++j)
+      {
+         current[i + j] ^= in[j];
+      }
+
+      i += numLiterals;
+      in += numLiterals;
+   }
+}
+
+// Drops the oldest entries in the way of a new entry of the given size, returning the offset to write it at
+std::size_t RewindBuffer::makeRoom(std::size_t size)
+{
+   DM_ASSERT(size <= storage.size());
+
+   std::size_t offset = writeOffset;
+   if (offset + size > storage.size())
+   {
+      // Entries are never split across the end of the ring, so wrap around (the entries left past the write offset are
+      // the oldest, and have to go first to keep the ring in order)
+      while (!entries.empty() && entries.front().offset >= writeOffset)
+      {
+         numBytesUsed -= entries.front().size;
+         entries.pop_front();
+      }
+
+      offset = 0;
+   }
+
+   while (!entries.empty() && entries.front().offset >= offset && entries.front().offset < offset + size)
+   {
+      numBytesUsed -= entries.front().size;
+      entries.pop_front();
+   }
+
+   return offset;
+}
+
+} // namespace DotMatrix
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace DotMatrix
+{
+
+// History of machine snapshots for rewinding, kept within a fixed memory budget
+//
+// Only the newest snapshot is kept whole. Every older one is stored as the XOR of it and the snapshot after it, run
+// length encoded (consecutive frames differ in very few bytes, so runs of zeros make up nearly all of it), in a ring that
+// drops the oldest snapshots to make room for new ones.
+class RewindBuffer
+{
+public:
+   RewindBuffer(std::size_t capacityBytes);
+
+   void clear();
+
+   // Snapshots are expected to all be the same size (a snapshot of a different size starts a new history)
+   void push(const std::vector<uint8_t>& snapshot);
+
+   // Replaces the current snapshot with the one pushed before it, returning false if there are no older snapshots left
+   bool stepBack();
+
+   bool empty() const
+   {
+      return current.empty();
+   }
+
+   const std::vector<uint8_t>& getCurrent() const
+   {
+      return current;
+   }
+
+   std::size_t getNumSnapshots() const
+   {
+      return current.empty() ? 0 : entries.size() + 1;
+   }
+
+   // Bytes used by the ring (not counting the current snapshot)
+   std::size_t getNumBytesUsed() const
+   {
+      return numBytesUsed;
+   }
+
+   std::size_t getCapacity() const
+   {
+      return storage.size();
+   }
+
+private:
+   struct Entry
+   {
+      std::size_t offset = 0;
+      std::size_t size = 0;
+   };
+
+   void encodeDelta(const std::vector<uint8_t>& snapshot);
+   void applyDelta(const Entry& entry);
+   std::size_t makeRoom(std::size_t size);
+
+   std::vector<uint8_t> storage;
+   std::deque<Entry> entries;
+   std::size_t writeOffset = 0;
+   std::size_t numBytesUsed = 0;
+
+   std::vector<uint8_t> current;
+   std::vector<uint8_t> delta;
+};
+
+} // namespace DotMatrix
@@ -0,0 +1,152 @@
+#include "GameBoy/AudioCapture.h"
+#include "GameBoy/WavFile.h"
+
+#include <chrono>
+
+namespace DotMatrix
+{
+
+namespace
+{
+   DM_STATIC_ASSERT(sizeof(AudioSample) == 2 * sizeof(int16_t), "Audio samples are not packed stereo pairs!");
+
+   // How much audio the queues can hold while the writer thread is busy with the disk
+   const double kQueueDuration = 1.0;
+
+   // How long the writer thread sleeps when it runs out of samples
+   const std::chrono::milliseconds kWriteInterval(10);
+
+   // Most samples written to disk at once (per queue)
+   const std::size_t kChunkSize = 4096;
+
+   // Channel samples range from -15 to 15
+   const int16_t kChannelScale = 2048;
+
+   const std::array<const char*, 4> kChannelNames = { "square1", "square2", "wave", "noise" };
+
+   std::size_t queueCapacity(uint32_t sampleRate)
+   {
+      return static_cast<std::size_t>(sampleRate * kQueueDuration);
+   }
+
+   std::filesystem::path getChannelPath(const std::filesystem::path& path, const char* channelName)
+   {
+      std::filesystem::path channelPath = path;
+      channelPath.replace_filename(path.stem().string() + "_" + channelName + path.extension().string());
+
+      return channelPath;
+   }
+}
+
+// static
+std::unique_ptr<AudioCapture> AudioCapture::create(const std::filesystem::path& path, uint32_t mixSampleRate, bool captureChannels, std::string& error)
+{
+   std::unique_ptr<AudioCapture> capture(new AudioCapture(mixSampleRate, captureChannels));
+
+   capture->mixFile = std::make_unique<WavFile>(path, mixSampleRate, 2);
+   if (!capture->mixFile->isOpen())
+   {
+      error = "Unable to open " + path.string();
+      return nullptr;
+   }
+
+   if (captureChannels)
+   {
+      for (std::size_t i = 0; i < capture->channelFiles.size(); ++i)
+      {
+         std::filesystem::path channelPath = getChannelPath(path, kChannelNames[i]);
+
+         capture->channelFiles[i] = std::make_unique<WavFile>(channelPath, static_cast<uint32_t>(SoundController::kSampleRate), 1);
+         if (!capture->channelFiles[i]->isOpen())
+         {
+            error = "Unable to open " + channelPath.string();
+            return nullptr;
+         }
+      }
+   }
+
+   AudioCapture* capturePointer = capture.get();
+   capture->thread = std::thread([capturePointer]()
+   {
+      capturePointer->threadMain();
+   });
+
+   return capture;
+}
+
+AudioCapture::AudioCapture(uint32_t mixSampleRate, bool captureChannels)
+   : mixQueue(queueCapacity(mixSampleRate))
+   , mixChunk(kChunkSize)
+{
+   if (captureChannels)
+   {
+      channelQueue = std::make_unique<SPSCQueue<ChannelSamples>>(queueCapacity(SoundController::kSampleRate));
+      channelChunk.resize(kChunkSize);
+      channelValues.resize(kChunkSize);
+   }
+}
+
+AudioCapture::~AudioCapture()
+{
+   if (thread.joinable())
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         exiting = true;
+      }
+
+      exitCondition.notify_all();
+      thread.join();
+   }
+}
+
+void AudioCapture::threadMain()
+{
+   while (true)
+   {
+      // Checked before writing, so that everything queued before the capture was stopped makes it to the files
+      bool exitRequested = exiting;
+
+      if (writeQueuedSamples() == 0)
+      {
+         if (exitRequested)
+         {
+            break;
+         }
+
+         std::unique_lock<std::mutex> lock(mutex);
+         exitCondition.wait_for(lock, kWriteInterval, [this]() { return exiting.load(); });
+      }
+   }
+}
+
+std::size_t AudioCapture::writeQueuedSamples()
+{
+   std::size_t numMixSamples = mixQueue.tryPop(mixChunk.data(), mixChunk.size());
+   if (numMixSamples > 0)
+   {
+      mixFile->write(&mixChunk[0].left, numMixSamples * 2);
+   }
+
+   std::size_t numChannelSamples = 0;
+   if (channelQueue)
+   {
+      numChannelSamples = channelQueue->tryPop(channelChunk.data(), channelChunk.size());
+      if (numChannelSamples > 0)
+      {
+         for (std::size_t channel = 0; channel < channelFiles.size(); ++channel)
+         {
+            for (std::size_t i = 0; i < numChannelSamples; ++i)
+            {
+               channelValues[i] = channelChunk[i][channel] * kChannelScale;
+            }
+
+            channelFiles[channel]->write(channelValues.data(), numChannelSamples);
+         }
+      }
+   }
+
+   return numMixSamples + numChannelSamples;
+}
+
+} // namespace DotMatrix
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Core/Assert.h"
+#include "Core/SPSCQueue.h"
+
+#include "GameBoy/SoundController.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace DotMatrix
+{
+
+class WavFile;
+
+// One native rate sample from each channel, in the order square 1, square 2, wave, noise
+using ChannelSamples = std::array<int8_t, 4>;
+
+// Streams audio to WAV files from a background thread
+//
+// Samples are handed over through fixed capacity queues, so the emulation thread never waits on the disk. If the writer
+// thread falls a whole queue behind, new samples are dropped (and counted) rather than stalling emulation.
+class AudioCapture
+{
+public:
+   // The mix is written to path, and each channel (if requested) to a file next to it with the channel name appended
+   static std::unique_ptr<AudioCapture> create(const std::filesystem::path& path, uint32_t mixSampleRate, bool captureChannels, std::string& error);
+
+   // Writes out everything still queued before finishing the files
+   ~AudioCapture();
+
+   bool capturesChannels() const
+   {
+      return channelQueue != nullptr;
+   }
+
+   // Emulation thread only
+   void writeMix(const AudioSample* samples, std::size_t numSamples)
+   {
+      std::size_t numPushed = mixQueue.tryPush(samples, numSamples);
+      numDroppedSamples += numSamples - numPushed;
+   }
+
+   // Emulation thread only
+   void writeChannels(const ChannelSamples& samples)
+   {
+      DM_ASSERT(channelQueue);
+
+      if (!channelQueue->tryPush(samples))
+      {
+         ++numDroppedSamples;
+      }
+   }
+
+   // Samples that didn't fit in a queue (and so are missing from the files)
+   uint64_t getNumDroppedSamples() const
+   {
+      return numDroppedSamples;
+   }
+
+private:
+   AudioCapture(uint32_t mixSampleRate, bool captureChannels);
+
+   void threadMain();
+   std::size_t writeQueuedSamples();
+
+   SPSCQueue<AudioSample> mixQueue;
+   std::unique_ptr<SPSCQueue<ChannelSamples>> channelQueue;
+
+   // Writer thread only (once it has started)
+   std::unique_ptr<WavFile> mixFile;
+   std::array<std::unique_ptr<WavFile>, 4> channelFiles;
+   std::vector<AudioSample> mixChunk;
+   std::vector<ChannelSamples> channelChunk;
+   std::vector<int16_t> channelValues;
+
+   std::thread thread;
+   std::mutex mutex;
+   std::condition_variable exitCondition;
+   std::atomic_bool exiting = false;
+
+   uint64_t numDroppedSamples = 0;
+};
+
+} // namespace DotMatrix
@@ -0,0 +1,160 @@
+#include "Core/Assert.h"
+
+#include "GameBoy/BandLimitedBuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace DotMatrix
+{
+
+namespace
+{
+   const std::size_t kKernelWidth = 16; // Output samples touched by each step
+   const int32_t kKernelBits = 14;
+   const int32_t kKernelUnit = 1 << kKernelBits;
+
+   // The integrated output leaks away slowly, acting as a high-pass filter (like the capacitor on the Game Boy's output).
+   // The leak is per output sample, so the corner is at sampleRate / (2 * pi * 2^kHighPassShift) and moves with the rate:
+   // about 14 Hz at 44.1 kHz, 15 Hz at 48 kHz and 20 Hz at 65536 Hz, all well below anything the sound channels produce.
+   const int32_t kHighPassShift = 9;
+
+   // Just below Nyquist, as a fraction of the output sample rate
+   const double kCutoff = 0.45;
+
+   template<std::size_t kNumPhases>
+   using Kernel = std::array<std::array<int32_t, kKernelWidth>, kNumPhases>;
+
+   template<std::size_t kNumPhases>
+   Kernel<kNumPhases> generateKernel()
+   {
+      static const double kPi = 3.14159265358979323846;
+      static const double kHalfWidth = kKernelWidth / 2;
+      static const std::size_t kStepsPerSample = kNumPhases * 8;
+      static const std::size_t kNumSteps = kKernelWidth * kStepsPerSample;
+
+      // Integrate a Blackman windowed sinc to get a band-limited step, sampled finely enough to land exactly on every phase
+      std::array<double, kNumSteps + 1> step = {};
+      double previousImpulse = 0.0;
+      for (std::size_t i = 1; i <= kNumSteps; ++i)
+      {
+         double t = static_cast<double>(i) / kStepsPerSample - kHalfWidth;
+
+         double x = 2.0 * kCutoff * t;
+         double sinc = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+         double window = 0.42 + 0.5 * std::cos(kPi * t / kHalfWidth) + 0.08 * std::cos(2.0 * kPi * t / kHalfWidth);
+         double impulse = 2.0 * kCutoff * sinc * window;
+
+         step[i] = step[i - 1] + 0.5 * (previousImpulse + impulse) / kStepsPerSample;
+         previousImpulse = impulse;
+      }
+
+      auto stepAt = [&step](int64_t stepIndex)
+      {
+         if (stepIndex <= 0)
+         {
+            return 0.0;
+         }
+         if (stepIndex >= static_cast<int64_t>(kNumSteps))
+         {
+            return 1.0;
+         }
+         return step[stepIndex] / step[kNumSteps];
+      };
+
+      // Each tap is the change in the step over one output sample
+      Kernel<kNumPhases> kernel = {};
+      for (std::size_t phase = 0; phase < kNumPhases; ++phase)
+      {
+         int32_t sum = 0;
+         std::size_t largestTap = 0;
+         for (std::size_t tap = 0; tap < kKernelWidth; ++tap)
+         {
+            // Step index (from the start of the window) of the end of the output sample covered by this tap
+            int64_t stepIndex = static_cast<int64_t>((tap + 1) * kStepsPerSample) - static_cast<int64_t>(phase * (kStepsPerSample / kNumPhases));
+            double value = stepAt(stepIndex) - stepAt(stepIndex - static_cast<int64_t>(kStepsPerSample));
+
+            kernel[phase][tap] = static_cast<int32_t>(std::lround(value * kKernelUnit));
+            sum += kernel[phase][tap];
+
+            if (kernel[phase][tap] > kernel[phase][largestTap])
+            {
+               largestTap = tap;
+            }
+         }
+
+         // Make sure every step adds up to exactly one unit, otherwise rounding error builds up as DC
+         kernel[phase][largestTap] += kKernelUnit - sum;
+      }
+
+      return kernel;
+   }
+}
+
+BandLimitedBuffer::BandLimitedBuffer(uint32_t clockRate, uint32_t outputSampleRate, uint32_t maxFrameClocks)
+   : sampleRate(outputSampleRate)
+   , clockFactor((static_cast<uint64_t>(outputSampleRate) << kTimeBits) / clockRate)
+{
+   DM_ASSERT(sampleRate < clockRate);
+
+   std::size_t maxFrameSamples = static_cast<std::size_t>((maxFrameClocks * clockFactor) >> kTimeBits) + 1;
+   buffer.resize(maxFrameSamples + kKernelWidth + 1);
+}
+
+void BandLimitedBuffer::addDelta(uint32_t clockTime, int32_t delta)
+{
+   static const Kernel<kNumPhases> kKernel = generateKernel<kNumPhases>();
+
+   uint64_t position = offset + clockTime * clockFactor;
+   std::size_t index = static_cast<std::size_t>(position >> kTimeBits);
+   std::size_t phase = static_cast<std::size_t>(position >> (kTimeBits - kPhaseBits)) & (kNumPhases - 1);
+   DM_ASSERT(index + kKernelWidth <= buffer.size());
+
+   const std::array<int32_t, kKernelWidth>& taps = kKernel[phase];
+   int32_t* output = &buffer[index];
+   for (std::size_t i = 0; i < kKernelWidth; ++i)
+   {
+      output[i] += taps[i] * delta;
+   }
+}
+
+void BandLimitedBuffer::endFrame(uint32_t frameClocks)
+{
+   offset += frameClocks * clockFactor;
+   DM_ASSERT(samplesAvailable() + kKernelWidth <= buffer.size());
+}
+
+std::size_t BandLimitedBuffer::readSamples(int16_t* samples, std::size_t maxSamples, std::size_t stride)
+{
+   std::size_t numSamples = std::min(maxSamples, samplesAvailable());
+
+   for (std::size_t i = 0; i < numSamples; ++i)
+   {
+      accumulator += buffer[i];
+
+      int32_t sample = accumulator >> kKernelBits;
+      sample = std::clamp<int32_t>(sample, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+      samples[i * stride] = static_cast<int16_t>(sample);
+
+      accumulator -= accumulator >> kHighPassShift;
+   }
+
+   // Shift the remaining samples (and the tail of any steps that extend past them) to the front
+   std::size_t numRemaining = samplesAvailable() - numSamples + kKernelWidth;
+   std::copy(buffer.begin() + numSamples, buffer.begin() + numSamples + numRemaining, buffer.begin());
+   std::fill(buffer.begin() + numRemaining, buffer.begin() + numSamples + numRemaining, 0);
+   offset -= static_cast<uint64_t>(numSamples) << kTimeBits;
+
+   return numSamples;
+}
+
+void BandLimitedBuffer::clear()
+{
+   offset = 0;
+   accumulator = 0;
+   std::fill(buffer.begin(), buffer.end(), 0);
+}
+
+} // namespace DotMatrix
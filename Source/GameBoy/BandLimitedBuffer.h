@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DotMatrix
+{
+
+// Turns a stream of timestamped amplitude changes into band-limited samples at an arbitrary output rate
+//
+// Each change is added as a band-limited step (a windowed sinc integrated over each output sample), so the signal never
+// has to be stepped or sampled at the source clock rate. Changes are timestamped in source clocks relative to the start
+// of the current frame, and ending a frame makes all samples before its end available to be read.
+class BandLimitedBuffer
+{
+public:
+   BandLimitedBuffer(uint32_t clockRate, uint32_t outputSampleRate, uint32_t maxFrameClocks);
+
+   uint32_t getSampleRate() const
+   {
+      return sampleRate;
+   }
+
+   void addDelta(uint32_t clockTime, int32_t delta);
+   void endFrame(uint32_t frameClocks);
+
+   std::size_t samplesAvailable() const
+   {
+      return static_cast<std::size_t>(offset >> kTimeBits);
+   }
+
+   // Writes up to maxSamples samples, each stride int16_t values apart, and returns the number written
+   std::size_t readSamples(int16_t* samples, std::size_t maxSamples, std::size_t stride);
+
+   void clear();
+
+private:
+   static const uint32_t kTimeBits = 32;
+   static const uint32_t kPhaseBits = 5;
+   static const uint32_t kNumPhases = 1 << kPhaseBits;
+
+   uint32_t sampleRate = 0;
+   uint64_t clockFactor = 0; // Output samples per clock, with kTimeBits of fraction
+   uint64_t offset = 0; // Start of the current frame, in output samples with kTimeBits of fraction
+   int32_t accumulator = 0;
+   std::vector<int32_t> buffer;
+};
+
+} // namespace DotMatrix
@@ -312,14 +312,15 @@ void CPU::Operand::write16(uint16_t value)
 }
 
 CPU::CPU(GameBoy& gb)
-   : reg({})
-   , gameBoy(gb)
-   , ime(false)
-   , halted(false)
-   , stopped(false)
-   , interruptEnableRequested(false)
-   , freezePC(false)
+   : gameBoy(gb)
 {
+   reset();
+}
+
+void CPU::reset()
+{
+   static_cast<CPUState&>(*this) = CPUState();
+
    reg.af = 0x01B0;
    reg.bc = 0x0013;
    reg.de = 0x00D8;
@@ -328,6 +329,44 @@ CPU::CPU(GameBoy& gb)
    reg.pc = 0x0100;
 }
 
+void CPU::saveState(Archive& archive) const
+{
+   archive.write(reg.af);
+   archive.write(reg.bc);
+   archive.write(reg.de);
+   archive.write(reg.hl);
+   archive.write(reg.sp);
+   archive.write(reg.pc);
+
+   archive.write(ime);
+   archive.write(halted);
+   archive.write(stopped);
+   archive.write(interruptEnableRequested);
+   archive.write(freezePC);
+}
+
+bool CPU::loadState(ArchiveView& archive)
+{
+   return archive.read(reg.af) && archive.read(reg.bc) && archive.read(reg.de) && archive.read(reg.hl) && archive.read(reg.sp) && archive.read(reg.pc)
+      && archive.read(ime) && archive.read(halted) && archive.read(stopped) && archive.read(interruptEnableRequested) && archive.read(freezePC);
+}
+
+void CPU::hashState(Hasher& hasher) const
+{
+   hasher.write(reg.af);
+   hasher.write(reg.bc);
+   hasher.write(reg.de);
+   hasher.write(reg.hl);
+   hasher.write(reg.sp);
+   hasher.write(reg.pc);
+
+   hasher.write(ime);
+   hasher.write(halted);
+   hasher.write(stopped);
+   hasher.write(interruptEnableRequested);
+   hasher.write(freezePC);
+}
+
 void CPU::step()
 {
    DM_ASSERT(!stopped);
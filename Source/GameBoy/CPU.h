@@ -1,9 +1,12 @@
 #pragma once
 
+#include "Core/Archive.h"
 #include "Core/Assert.h"
 #include "Core/Enum.h"
+#include "Core/Hash.h"
 
 #include <cstdint>
+#include <type_traits>
 
 namespace DotMatrix
 {
@@ -153,40 +156,10 @@ struct Operation
    }
 };
 
-class CPU
+// Register file and execution flags, kept apart from the CPU's link to the rest of the machine so that they can be
+// copied as plain memory (see GameBoy::Snapshot)
+struct CPUState
 {
-public:
-   static const uint8_t kClockCyclesPerMachineCycle = 4;
-   static const uint64_t kClockSpeed = 4194304; // 4.194304 MHz TODO handle GBC / SGB
-   static const uint64_t kMachineSpeed = kClockSpeed / kClockCyclesPerMachineCycle;
-
-   CPU(GameBoy& gb);
-
-   void step();
-
-   bool isStopped() const
-   {
-      return stopped;
-   }
-
-   void resume()
-   {
-      stopped = false;
-   }
-
-   uint16_t getPC() const
-   {
-      return reg.pc;
-   }
-
-   void setPC(uint16_t address)
-   {
-      reg.pc = address;
-   }
-
-private:
-   class Operand;
-
    struct Registers
    {
       union
@@ -232,6 +205,74 @@ private:
       uint16_t pc;      // program counter
    };
 
+   Registers reg = {};
+   bool ime = false;
+
+   bool halted = false;
+   bool stopped = false;
+   bool interruptEnableRequested = false;
+   bool freezePC = false;
+};
+
+DM_STATIC_ASSERT(std::is_trivially_copyable_v<CPUState>, "CPU state can't be copied as plain memory!");
+
+class CPU : private CPUState
+{
+public:
+   static const uint8_t kClockCyclesPerMachineCycle = 4;
+   static const uint64_t kClockSpeed = 4194304; // 4.194304 MHz TODO handle GBC / SGB
+   static const uint64_t kMachineSpeed = kClockSpeed / kClockCyclesPerMachineCycle;
+
+   CPU(GameBoy& gb);
+
+   // Back to the register values the bootstrap leaves behind
+   void reset();
+
+   void step();
+
+   bool isStopped() const
+   {
+      return stopped;
+   }
+
+   void resume()
+   {
+      stopped = false;
+   }
+
+   uint16_t getPC() const
+   {
+      return reg.pc;
+   }
+
+   void setPC(uint16_t address)
+   {
+      reg.pc = address;
+   }
+
+   void saveState(Archive& archive) const;
+   bool loadState(ArchiveView& archive);
+   void hashState(Hasher& hasher) const;
+
+   void saveSnapshot(CPUState& state) const
+   {
+      state = *this;
+   }
+
+   void loadSnapshot(const CPUState& state)
+   {
+      static_cast<CPUState&>(*this) = state;
+   }
+
+   // Like saving a snapshot of the other CPU and loading it, without the copy in between (see GameBoy::fork())
+   void copyStateFrom(const CPU& other)
+   {
+      loadSnapshot(other);
+   }
+
+private:
+   class Operand;
+
    enum class Flag : uint8_t
    {
       Zero = 1 << 7,      // Zero flag
@@ -282,14 +323,7 @@ private:
    void execute8(Operation operation);
    void execute16(Operation operation);
 
-   Registers reg;
    GameBoy& gameBoy;
-   bool ime;
-
-   bool halted;
-   bool stopped;
-   bool interruptEnableRequested;
-   bool freezePC;
 };
 
 } // namespace DotMatrix
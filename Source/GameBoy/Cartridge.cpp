@@ -15,22 +15,22 @@ namespace
    const uint16_t kHeaderOffset = 0x0100;
    const uint16_t kHeaderSize = 0x0050;
 
-   Cartridge::Header parseHeader(const std::vector<uint8_t>& data)
+   Cartridge::Header parseHeader(const RomImage& image)
    {
       DM_STATIC_ASSERT(sizeof(Cartridge::Header) == kHeaderSize);
-      DM_ASSERT(data.size() >= kHeaderOffset + kHeaderSize);
+      DM_ASSERT(image.size() >= kHeaderOffset + kHeaderSize);
 
       Cartridge::Header header;
-      std::memcpy(&header, &data.data()[kHeaderOffset], kHeaderSize);
+      std::memcpy(&header, &image.data()[kHeaderOffset], kHeaderSize);
 
       return header;
    }
 
-   bool performHeaderChecksum(const Cartridge::Header& header, const std::vector<uint8_t>& data)
+   bool performHeaderChecksum(const Cartridge::Header& header, const RomImage& image)
    {
       // Complement check, program will not run if incorrect
       // x=0:FOR i=0134h TO 014Ch:x=x-MEM[i]-1:NEXT
-      const uint8_t* mem = data.data();
+      const uint8_t* mem = image.data();
 
       uint8_t x = 0;
       for (uint16_t i = 0x0134; i <= 0x014C; ++i)
@@ -42,14 +42,14 @@ namespace
    }
 
 #if DM_DEBUG
-   bool performGlobalChecksum(const Cartridge::Header& header, const std::vector<uint8_t>& data)
+   bool performGlobalChecksum(const Cartridge::Header& header, const RomImage& image)
    {
       // Checksum (higher byte first) produced by adding all bytes of a cartridge except for two checksum bytes and taking
       // two lower bytes of the result. (GameBoy ignores this value.)
-      const uint8_t* mem = data.data();
+      const uint8_t* mem = image.data();
 
       uint16_t x = 0;
-      for (size_t i = 0; i < data.size(); ++i)
+      for (size_t i = 0; i < image.size(); ++i)
       {
          x += mem[i];
       }
@@ -143,29 +143,29 @@ namespace
 }
 
 // static
-std::unique_ptr<Cartridge> Cartridge::fromData(std::vector<uint8_t> data, std::string& error)
+std::unique_ptr<Cartridge> Cartridge::fromImage(std::shared_ptr<const RomImage> image, std::string& error)
 {
-   if (data.size() < kHeaderOffset + kHeaderSize)
+   if (!image || image->size() < kHeaderOffset + kHeaderSize)
    {
       error = "Cartridge provided insufficient data";
       return nullptr;
    }
 
-   Header header = parseHeader(data);
-   if (!performHeaderChecksum(header, data))
+   Header header = parseHeader(*image);
+   if (!performHeaderChecksum(header, *image))
    {
       error = "Cartridge failed header checksum";
       return nullptr;
    }
 
 #if DM_DEBUG
-   if (!performGlobalChecksum(header, data))
+   if (!performGlobalChecksum(header, *image))
    {
       DM_LOG_WARNING("Cartridge failed global checksum");
    }
 #endif // DM_DEBUG
 
-   std::unique_ptr<Cartridge> cart(new Cartridge(std::move(data), header));
+   std::unique_ptr<Cartridge> cart(new Cartridge(std::move(image), header));
 
    std::unique_ptr<MemoryBankController> mbc;
    switch (header.type)
@@ -211,6 +211,45 @@ std::unique_ptr<Cartridge> Cartridge::fromData(std::vector<uint8_t> data, std::s
    return cart;
 }
 
+// static
+std::unique_ptr<Cartridge> Cartridge::fromData(std::vector<uint8_t> data, std::string& error)
+{
+   return fromImage(RomImage::fromData(std::move(data)), error);
+}
+
+// static
+std::unique_ptr<Cartridge> Cartridge::fromGBSImage(std::vector<uint8_t> data, std::string& error)
+{
+   std::shared_ptr<const RomImage> image = RomImage::fromData(std::move(data));
+   if (image->size() < kHeaderOffset + kHeaderSize)
+   {
+      error = "GBS image provided insufficient data";
+      return nullptr;
+   }
+
+   Header header = parseHeader(*image);
+   if (!performHeaderChecksum(header, *image))
+   {
+      error = "GBS image failed header checksum";
+      return nullptr;
+   }
+
+   std::unique_ptr<Cartridge> cart(new Cartridge(std::move(image), header));
+   cart->setController(std::make_unique<MBCGBS>(*cart));
+
+   return cart;
+}
+
+std::unique_ptr<Cartridge> Cartridge::fork() const
+{
+   DM_ASSERT(controller);
+
+   std::unique_ptr<Cartridge> child(new Cartridge(romImage, header));
+   child->setController(controller->fork(*child));
+
+   return child;
+}
+
 const char* Cartridge::getTypeName(Type type)
 {
    switch (type)
@@ -292,8 +331,10 @@ const char* Cartridge::getTypeName(Type type)
    }
 }
 
-Cartridge::Cartridge(std::vector<uint8_t> data, const Header& headerData)
-   : cartData(std::move(data))
+Cartridge::Cartridge(std::shared_ptr<const RomImage> image, const Header& headerData)
+   : romImage(std::move(image))
+   , romData(romImage->data())
+   , romSize(romImage->size())
    , header(headerData)
    , cartTitle({})
    , ramPresent(cartHasRAM(header.type))
@@ -5,6 +5,7 @@
 
 #include "GameBoy/GameBoy.h"
 #include "GameBoy/MemoryBankController.h"
+#include "GameBoy/RomImage.h"
 
 #include <array>
 #include <cstdint>
@@ -17,18 +18,32 @@ namespace DotMatrix
 class Cartridge
 {
 public:
+   // The image can be shared with any number of other cartridges (see getRomImage())
+   static std::unique_ptr<Cartridge> fromImage(std::shared_ptr<const RomImage> image, std::string& error);
    static std::unique_ptr<Cartridge> fromData(std::vector<uint8_t> data, std::string& error);
 
+   // Wraps a ROM image built to play a GBS file (see GBS::createCartridge()), which is banked by MBCGBS
+   static std::unique_ptr<Cartridge> fromGBSImage(std::vector<uint8_t> data, std::string& error);
+
+   // Another cartridge for the same game in the same state, which shares the ROM image and RAM banks with this one (RAM
+   // banks are only copied once either cartridge writes to them)
+   std::unique_ptr<Cartridge> fork() const;
+
    const char* title() const
    {
       return cartTitle.data();
    }
 
+   const std::shared_ptr<const RomImage>& getRomImage() const
+   {
+      return romImage;
+   }
+
    uint8_t data(size_t address) const
    {
-      if (address < cartData.size())
+      if (address < romSize)
       {
-         return cartData[address];;
+         return romData[address];
       }
 
       return GameBoy::kInvalidAddressByte;
@@ -52,18 +67,59 @@ public:
       controller->tick(dt);
    }
 
+   void reset()
+   {
+      DM_ASSERT(controller);
+      controller->reset();
+   }
+
    Archive saveRAM() const
    {
       DM_ASSERT(controller);
       return controller->saveRAM();
    }
 
-   bool loadRAM(Archive& ramData)
+   bool loadRAM(ArchiveView& ramData)
    {
       DM_ASSERT(controller);
       return controller->loadRAM(ramData);
    }
 
+   // Banking state and RAM, tagged with the header checksums so that a state is only ever loaded into the same game
+   void saveState(Archive& archive) const
+   {
+      DM_ASSERT(controller);
+
+      archive.write(header.headerChecksum);
+      archive.write(header.globalChecksum);
+      controller->saveState(archive);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      DM_ASSERT(controller);
+
+      uint8_t headerChecksum = 0;
+      std::array<uint8_t, 2> globalChecksum = {};
+      if (!archive.read(headerChecksum) || !archive.read(globalChecksum))
+      {
+         return false;
+      }
+
+      if (headerChecksum != header.headerChecksum || globalChecksum != header.globalChecksum)
+      {
+         return false;
+      }
+
+      return controller->loadState(archive);
+   }
+
+   void hashState(Hasher& hasher)
+   {
+      DM_ASSERT(controller);
+      controller->hashState(hasher);
+   }
+
    bool wroteToRamThisFrame() const
    {
       DM_ASSERT(controller);
@@ -201,14 +257,16 @@ public:
    static const char* getTypeName(Type type);
 
 private:
-   Cartridge(std::vector<uint8_t> data, const Header& headerData);
+   Cartridge(std::shared_ptr<const RomImage> image, const Header& headerData);
 
    void setController(std::unique_ptr<MemoryBankController> mbc)
    {
       controller = std::move(mbc);
    }
 
-   std::vector<uint8_t> cartData;
+   std::shared_ptr<const RomImage> romImage;
+   const uint8_t* romData = nullptr;
+   std::size_t romSize = 0;
    Header header;
    std::array<char, 17> cartTitle;
 
@@ -0,0 +1,242 @@
+#include "Core/Assert.h"
+
+#include "GameBoy/Cartridge.h"
+#include "GameBoy/GBS.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace DotMatrix
+{
+
+namespace
+{
+   const std::size_t kHeaderSize = 0x70;
+   const std::size_t kStringSize = 32;
+
+   // The driver lives between the cartridge header and the lowest address GBS code can be loaded at
+   const uint16_t kDriverAddress = 0x0150;
+   const uint16_t kMinLoadAddress = 0x0400;
+
+   const uint16_t kCartridgeHeaderOffset = 0x0100;
+   const std::size_t kBankSize = 0x4000;
+
+   uint16_t readWord(const std::vector<uint8_t>& data, std::size_t offset)
+   {
+      return static_cast<uint16_t>(data[offset] | (data[offset + 1] << 8));
+   }
+
+   std::string readString(const std::vector<uint8_t>& data, std::size_t offset)
+   {
+      // Not necessarily null terminated
+      const char* chars = reinterpret_cast<const char*>(&data[offset]);
+      return std::string(chars, strnlen(chars, kStringSize));
+   }
+
+   // Writes instructions one after another into a ROM image
+   class CodeWriter
+   {
+   public:
+      CodeWriter(std::vector<uint8_t>& romImage, uint16_t startAddress)
+         : image(romImage)
+         , address(startAddress)
+      {
+      }
+
+      uint16_t getAddress() const
+      {
+         return address;
+      }
+
+      CodeWriter& byte(uint8_t value)
+      {
+         DM_ASSERT(address < image.size());
+         image[address++] = value;
+         return *this;
+      }
+
+      CodeWriter& word(uint16_t value)
+      {
+         return byte(value & 0x00FF).byte(value >> 8);
+      }
+
+   private:
+      std::vector<uint8_t>& image;
+      uint16_t address = 0;
+   };
+
+   namespace Opcode
+   {
+      enum Enum : uint8_t
+      {
+         NOP = 0x00,
+         JR = 0x18,
+         LD_SP_d16 = 0x31,
+         LD_A_d8 = 0x3E,
+         HALT = 0x76,
+         XOR_A = 0xAF,
+         JP = 0xC3,
+         CALL = 0xCD,
+         RETI = 0xD9,
+         LDH_a8_A = 0xE0,
+         LD_a16_A = 0xEA,
+         DI = 0xF3,
+         EI = 0xFB
+      };
+   }
+}
+
+// static
+std::unique_ptr<GBS> GBS::fromData(std::vector<uint8_t> data, std::string& error)
+{
+   if (data.size() <= kHeaderSize || std::memcmp(data.data(), "GBS", 3) != 0)
+   {
+      error = "Not a GBS file";
+      return nullptr;
+   }
+
+   if (data[0x03] != 1)
+   {
+      error = "Unsupported GBS version";
+      return nullptr;
+   }
+
+   std::unique_ptr<GBS> gbs(new GBS(std::move(data)));
+
+   if (gbs->numSongs == 0 || gbs->firstSong >= gbs->numSongs)
+   {
+      error = "GBS file has an invalid song count";
+      return nullptr;
+   }
+
+   if (gbs->loadAddress < kMinLoadAddress || gbs->loadAddress >= 0x8000)
+   {
+      error = "GBS file has an unsupported load address";
+      return nullptr;
+   }
+
+   return gbs;
+}
+
+GBS::GBS(std::vector<uint8_t> data)
+   : numSongs(data[0x04])
+   , firstSong(data[0x05] - 1)
+   , loadAddress(readWord(data, 0x06))
+   , initAddress(readWord(data, 0x08))
+   , playAddress(readWord(data, 0x0A))
+   , stackPointer(readWord(data, 0x0C))
+   , timerModulo(data[0x0E])
+   , timerControl(data[0x0F])
+   , title(readString(data, 0x10))
+   , author(readString(data, 0x30))
+   , copyright(readString(data, 0x50))
+{
+   code.assign(data.begin() + kHeaderSize, data.end());
+}
+
+std::unique_ptr<Cartridge> GBS::createCartridge(uint8_t song, std::string& error) const
+{
+   if (song >= numSongs)
+   {
+      error = "Invalid song index";
+      return nullptr;
+   }
+
+   // The code is loaded into a flat image starting at the load address, with each bank following the last
+   std::size_t imageSize = 2 * kBankSize;
+   while (imageSize < loadAddress + code.size())
+   {
+      imageSize *= 2;
+   }
+
+   std::vector<uint8_t> image(imageSize, 0x00);
+   std::copy(code.begin(), code.end(), image.begin() + loadAddress);
+
+   // Restart vectors are relative to the load address
+   for (uint16_t vector = 0x0000; vector <= 0x0038; vector += 0x0008)
+   {
+      CodeWriter(image, vector).byte(Opcode::JP).word(loadAddress + vector);
+   }
+
+   // Entry point
+   CodeWriter(image, 0x0100).byte(Opcode::NOP).byte(Opcode::JP).word(kDriverAddress);
+
+   CodeWriter driver(image, kDriverAddress);
+   driver
+      .byte(Opcode::DI)
+      .byte(Opcode::LD_SP_d16).word(stackPointer)
+
+      // The LCD is never scanned, and nothing starts out pending
+      .byte(Opcode::XOR_A)
+      .byte(Opcode::LDH_a8_A).byte(0x40)
+      .byte(Opcode::LDH_a8_A).byte(0x0F)
+
+      // Power up the APU and route every channel to both sides at full volume
+      .byte(Opcode::LD_A_d8).byte(0x80)
+      .byte(Opcode::LDH_a8_A).byte(0x26)
+      .byte(Opcode::LD_A_d8).byte(0x77)
+      .byte(Opcode::LDH_a8_A).byte(0x24)
+      .byte(Opcode::LD_A_d8).byte(0xFF)
+      .byte(Opcode::LDH_a8_A).byte(0x25)
+
+      .byte(Opcode::LD_A_d8).byte(0x01)
+      .byte(Opcode::LD_a16_A).word(0x2000)
+
+      // Timer (the CGB double speed bit is ignored), and the interrupt that calls the play routine
+      .byte(Opcode::LD_A_d8).byte(timerModulo)
+      .byte(Opcode::LDH_a8_A).byte(0x06)
+      .byte(Opcode::LD_A_d8).byte(usesTimer() ? timerControl & 0x07 : 0x00)
+      .byte(Opcode::LDH_a8_A).byte(0x07)
+      .byte(Opcode::LD_A_d8).byte(usesTimer() ? 0x04 : 0x01)
+      .byte(Opcode::LDH_a8_A).byte(0xFF)
+
+      .byte(Opcode::LD_A_d8).byte(song)
+      .byte(Opcode::CALL).word(initAddress)
+      .byte(Opcode::EI);
+
+   uint16_t idleAddress = driver.getAddress();
+   driver
+      .byte(Opcode::HALT)
+      .byte(Opcode::JR).byte(static_cast<uint8_t>(idleAddress - (driver.getAddress() + 1)));
+
+   uint16_t playHandlerAddress = driver.getAddress();
+   driver
+      .byte(Opcode::CALL).word(playAddress)
+      .byte(Opcode::RETI);
+   DM_ASSERT(driver.getAddress() <= kMinLoadAddress);
+
+   // VBlank and timer interrupts call the play routine (the others are never enabled)
+   CodeWriter(image, 0x0040).byte(Opcode::JP).word(playHandlerAddress);
+   CodeWriter(image, 0x0048).byte(Opcode::RETI);
+   CodeWriter(image, 0x0050).byte(Opcode::JP).word(playHandlerAddress);
+   CodeWriter(image, 0x0058).byte(Opcode::RETI);
+   CodeWriter(image, 0x0060).byte(Opcode::RETI);
+
+   // Cartridge header
+   Cartridge::Header header = {};
+   std::memcpy(header.title.data(), title.data(), std::min(title.size(), header.title.size()));
+   header.type = Cartridge::Type::ROMPlusRAM;
+   header.ramSize = Cartridge::RAMSize::Size8KBytes;
+
+   uint8_t romSize = 0;
+   while ((2 * kBankSize << romSize) < imageSize)
+   {
+      ++romSize;
+   }
+   header.romSize = static_cast<Cartridge::ROMSize>(romSize);
+
+   uint8_t* headerBytes = reinterpret_cast<uint8_t*>(&header);
+   uint8_t checksum = 0;
+   for (std::size_t i = 0x0134 - kCartridgeHeaderOffset; i <= 0x014C - kCartridgeHeaderOffset; ++i)
+   {
+      checksum = checksum - headerBytes[i] - 1;
+   }
+   header.headerChecksum = checksum;
+
+   // Keep the entry point that was written above
+   std::memcpy(&image[kCartridgeHeaderOffset + sizeof(header.entryPoint)], headerBytes + sizeof(header.entryPoint), sizeof(header) - sizeof(header.entryPoint));
+
+   return Cartridge::fromGBSImage(std::move(image), error);
+}
+
+} // namespace DotMatrix
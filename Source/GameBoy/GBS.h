@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace DotMatrix
+{
+
+class Cartridge;
+
+// Game Boy Sound System file: a game's sound driver and music data (without the rest of the game), plus a header that
+// describes how to start a song and how often to call the driver's play routine
+class GBS
+{
+public:
+   static std::unique_ptr<GBS> fromData(std::vector<uint8_t> data, std::string& error);
+
+   uint8_t getNumSongs() const
+   {
+      return numSongs;
+   }
+
+   // Index of the song to play by default (songs are numbered from 0)
+   uint8_t getFirstSong() const
+   {
+      return firstSong;
+   }
+
+   const std::string& getTitle() const
+   {
+      return title;
+   }
+
+   const std::string& getAuthor() const
+   {
+      return author;
+   }
+
+   const std::string& getCopyright() const
+   {
+      return copyright;
+   }
+
+   // Whether the play routine is called from the timer interrupt (otherwise it has to be called on every VBlank, which the
+   // host signals by requesting the VBlank interrupt once per frame, since the LCD is kept off)
+   bool usesTimer() const
+   {
+      return (timerControl & 0x04) != 0x00;
+   }
+
+   // Builds a cartridge that starts the song, and then calls the play routine whenever its interrupt fires
+   std::unique_ptr<Cartridge> createCartridge(uint8_t song, std::string& error) const;
+
+private:
+   GBS(std::vector<uint8_t> data);
+
+   std::vector<uint8_t> code;
+
+   uint8_t numSongs = 0;
+   uint8_t firstSong = 0;
+   uint16_t loadAddress = 0;
+   uint16_t initAddress = 0;
+   uint16_t playAddress = 0;
+   uint16_t stackPointer = 0;
+   uint8_t timerModulo = 0;
+   uint8_t timerControl = 0;
+
+   std::string title;
+   std::string author;
+   std::string copyright;
+};
+
+} // namespace DotMatrix
@@ -33,9 +33,13 @@ namespace
          ShiftClock = 1 << 0
       };
    }
+
+   const uint32_t kStateMagic = 0x54534D44; // "DMST"
+   const uint32_t kMachineStateMagic = 0x534D4D44; // "DMMS"
+   const uint32_t kStateVersion = 1;
 }
 
-uint8_t GameBoy::SerialControlRegister::read() const
+uint8_t GameBoyState::SerialControlRegister::read() const
 {
    return startTransfer * SC::TransferStartFlag
       | 0x7E
@@ -43,7 +47,7 @@ uint8_t GameBoy::SerialControlRegister::read() const
       | useInternalClock * SC::ShiftClock;
 }
 
-void GameBoy::SerialControlRegister::write(uint8_t value)
+void GameBoyState::SerialControlRegister::write(uint8_t value)
 {
    startTransfer = value & SC::TransferStartFlag;
    // fastSpeed = value & SC::ClockSpeed; // CGB only
@@ -53,8 +57,11 @@ void GameBoy::SerialControlRegister::write(uint8_t value)
 GameBoy::GameBoy()
    : cpu(*this)
    , lcdController(*this)
-   , lastInputVals(P1::InMask)
 {
+   lastInputVals = P1::InMask;
+
+   // Starts out as the bootstrap leaves things (see setBootstrap())
+   lcdController.skipBootstrap();
 }
 
 // Need to define destructor in a location where the Cartridge class is defined, so a default deleter can be generated for it
@@ -62,6 +69,37 @@ GameBoy::~GameBoy()
 {
 }
 
+void GameBoy::reset()
+{
+   cpu.reset();
+   lcdController.reset();
+   soundController.reset();
+
+   static_cast<GameBoyState&>(*this) = GameBoyState();
+   lastInputVals = P1::InMask;
+   ram0Hash.markAllDirty();
+   ram1Hash.markAllDirty();
+
+   bool runBootstrap = false;
+#if DM_WITH_BOOTSTRAP
+   runBootstrap = !bootstrap.empty();
+#endif // DM_WITH_BOOTSTRAP
+
+   if (runBootstrap)
+   {
+      cpu.setPC(0x0000);
+   }
+   else
+   {
+      lcdController.skipBootstrap();
+   }
+
+   if (cart)
+   {
+      cart->reset();
+   }
+}
+
 void GameBoy::tick(double dt)
 {
    if (dt < 0.0)
@@ -129,7 +167,10 @@ void GameBoy::setBootstrap(std::vector<uint8_t> data)
    DM_ASSERT(cpu.getPC() == 0x0100 && data.size() == 256);
 
    bootstrap = std::move(data);
+
+   // The bootstrap starts from the power-on state, and sets up the display itself
    cpu.setPC(0x0000);
+   lcdController.reset();
 }
 #endif // DM_WITH_BOOTSTRAP
 
@@ -148,7 +189,7 @@ Archive GameBoy::saveCartRAM() const
    return cart->saveRAM();
 }
 
-bool GameBoy::loadCartRAM(Archive& ram)
+bool GameBoy::loadCartRAM(ArchiveView& ram)
 {
    if (!cart)
    {
@@ -158,6 +199,233 @@ bool GameBoy::loadCartRAM(Archive& ram)
    return cart->loadRAM(ram);
 }
 
+Archive GameBoy::saveState()
+{
+   Archive state;
+   saveState(state);
+
+   return state;
+}
+
+void GameBoy::saveState(Archive& state)
+{
+   saveState(state, true);
+}
+
+bool GameBoy::loadState(ArchiveView& state)
+{
+   return loadState(state, true);
+}
+
+void GameBoy::saveMachineState(Archive& state)
+{
+   saveState(state, false);
+}
+
+bool GameBoy::loadMachineState(ArchiveView& state)
+{
+   return loadState(state, false);
+}
+
+void GameBoy::saveState(Archive& state, bool includeFramebuffers)
+{
+   state.write(includeFramebuffers ? kStateMagic : kMachineStateMagic);
+   state.write(kStateVersion);
+
+   cpu.saveState(state);
+   lcdController.saveState(state, includeFramebuffers);
+   soundController.saveState(state);
+
+   state.write(cart != nullptr);
+   if (cart)
+   {
+      cart->saveState(state);
+   }
+
+   state.write(targetCycles);
+   state.write(totalCycles);
+
+   state.write(joypad);
+   state.write(lastInputVals);
+
+   state.write(counter);
+   state.write(timaOverloaded);
+   state.write(ifWritten);
+   state.write(timaReloadedWithTma);
+   state.write(lastTimerBit);
+
+   state.write(serialControlRegister.startTransfer);
+   state.write(serialControlRegister.useInternalClock);
+   state.write(serialCycles);
+
+#if DM_WITH_BOOTSTRAP
+   state.write(booting);
+#endif // DM_WITH_BOOTSTRAP
+
+   state.write(ram0);
+   state.write(ram1);
+   state.write(ramh);
+
+   state.write(p1);
+   state.write(sb);
+   state.write(tima);
+   state.write(tma);
+   state.write(tac);
+   state.write(ifr);
+   state.write(ie);
+}
+
+bool GameBoy::loadState(ArchiveView& state, bool includeFramebuffers)
+{
+   uint32_t magic = 0;
+   uint32_t version = 0;
+   if (!state.read(magic) || !state.read(version) || magic != (includeFramebuffers ? kStateMagic : kMachineStateMagic) || version != kStateVersion)
+   {
+      return false;
+   }
+
+   if (!cpu.loadState(state) || !lcdController.loadState(state, includeFramebuffers) || !soundController.loadState(state))
+   {
+      return false;
+   }
+
+   bool hasCart = false;
+   if (!state.read(hasCart) || hasCart != (cart != nullptr))
+   {
+      return false;
+   }
+
+   if (cart && !cart->loadState(state))
+   {
+      return false;
+   }
+
+   bool loaded = state.read(targetCycles) && state.read(totalCycles)
+      && state.read(joypad) && state.read(lastInputVals)
+      && state.read(counter) && state.read(timaOverloaded) && state.read(ifWritten) && state.read(timaReloadedWithTma) && state.read(lastTimerBit)
+      && state.read(serialControlRegister.startTransfer) && state.read(serialControlRegister.useInternalClock) && state.read(serialCycles)
+#if DM_WITH_BOOTSTRAP
+      && state.read(booting)
+#endif // DM_WITH_BOOTSTRAP
+      && state.read(ram0) && state.read(ram1) && state.read(ramh)
+      && state.read(p1) && state.read(sb) && state.read(tima) && state.read(tma) && state.read(tac) && state.read(ifr) && state.read(ie);
+
+   ram0Hash.markAllDirty();
+   ram1Hash.markAllDirty();
+   cartWroteToRam = false;
+
+   return loaded;
+}
+
+void GameBoy::saveSnapshot(Snapshot& snapshot)
+{
+   cpu.saveSnapshot(snapshot.cpu);
+   lcdController.saveSnapshot(snapshot.lcdController);
+   soundController.saveSnapshot(snapshot.soundController);
+   snapshot.gameBoy = *this;
+
+   snapshot.cart.clear();
+   if (cart)
+   {
+      cart->saveState(snapshot.cart);
+   }
+}
+
+void GameBoy::loadSnapshot(const Snapshot& snapshot)
+{
+   cpu.loadSnapshot(snapshot.cpu);
+   lcdController.loadSnapshot(snapshot.lcdController);
+   soundController.loadSnapshot(snapshot.soundController);
+   static_cast<GameBoyState&>(*this) = snapshot.gameBoy;
+
+   if (cart)
+   {
+      // Snapshots are only ever loaded into the instance (and so the cartridge) they were saved from
+      ArchiveView cartState = snapshot.cart.view();
+      bool loaded = cart->loadState(cartState);
+      DM_ASSERT(loaded && cartState.isAtEnd());
+   }
+
+   ram0Hash.markAllDirty();
+   ram1Hash.markAllDirty();
+   cartWroteToRam = false;
+}
+
+uint64_t GameBoy::stateHash()
+{
+   Hasher hasher;
+
+   cpu.hashState(hasher);
+   lcdController.hashState(hasher);
+   soundController.hashState(hasher);
+
+   hasher.write(cart != nullptr);
+   if (cart)
+   {
+      cart->hashState(hasher);
+   }
+
+   hasher.write(targetCycles);
+   hasher.write(totalCycles);
+
+   hasher.write(joypad);
+   hasher.write(lastInputVals);
+
+   hasher.write(counter);
+   hasher.write(timaOverloaded);
+   hasher.write(ifWritten);
+   hasher.write(timaReloadedWithTma);
+   hasher.write(lastTimerBit);
+
+   hasher.write(serialControlRegister.startTransfer);
+   hasher.write(serialControlRegister.useInternalClock);
+   hasher.write(serialCycles);
+
+#if DM_WITH_BOOTSTRAP
+   hasher.write(booting);
+#endif // DM_WITH_BOOTSTRAP
+
+   hasher.write(ram0Hash.hash(ram0.data()));
+   hasher.write(ram1Hash.hash(ram1.data()));
+   hasher.write(ramh);
+
+   hasher.write(p1);
+   hasher.write(sb);
+   hasher.write(tima);
+   hasher.write(tma);
+   hasher.write(tac);
+   hasher.write(ifr);
+   hasher.write(ie);
+
+   return hasher.finish();
+}
+
+std::unique_ptr<GameBoy> GameBoy::fork()
+{
+   std::unique_ptr<GameBoy> child = std::make_unique<GameBoy>();
+
+#if DM_WITH_BOOTSTRAP
+   child->bootstrap = bootstrap;
+#endif // DM_WITH_BOOTSTRAP
+
+   if (cart)
+   {
+      child->setCartridge(cart->fork());
+   }
+
+   // Each component's state is copied straight across (the cartridge is shared instead)
+   child->cpu.copyStateFrom(cpu);
+   child->lcdController.copyStateFrom(lcdController);
+   child->soundController.copyStateFrom(soundController);
+   static_cast<GameBoyState&>(*child) = *this;
+
+   // Work RAM is identical, so the hashes of its pages still hold
+   child->ram0Hash = ram0Hash;
+   child->ram1Hash = ram1Hash;
+
+   return child;
+}
+
 const char* GameBoy::title() const
 {
    if (!cart)
@@ -496,7 +764,6 @@ void GameBoy::writeIO(uint16_t address, uint8_t value)
          if (value == 0x01)
          {
             booting = false;
-            bootstrap.clear();
          }
          break;
       default:
@@ -656,14 +923,17 @@ void GameBoy::writeDirect(uint16_t address, uint8_t value)
    // Working RAM bank 0
    case 0xC000:
       ram0[address - 0xC000] = value;
+      ram0Hash.markDirty(address - 0xC000);
       break;
    // Working RAM bank 1
    case 0xD000:
       ram1[address - 0xD000] = value;
+      ram1Hash.markDirty(address - 0xD000);
       break;
    // Mirror of working ram
    case 0xE000:
       ram0[address - 0xE000] = value;
+      ram0Hash.markDirty(address - 0xE000);
       break;
    case 0xF000:
       switch (address & 0x0F00)
@@ -671,6 +941,7 @@ void GameBoy::writeDirect(uint16_t address, uint8_t value)
       // Mirror of working ram
       default:
          ram1[address - 0xF000] = value;
+         ram1Hash.markDirty(address - 0xF000);
          break;
       // Sprite attribute table
       case 0x0E00:
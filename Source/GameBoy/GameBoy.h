@@ -3,6 +3,7 @@
 #include "Core/Archive.h"
 #include "Core/Assert.h"
 #include "Core/Enum.h"
+#include "Core/Hash.h"
 
 #include "GameBoy/CPU.h"
 #include "GameBoy/LCDController.h"
@@ -11,6 +12,7 @@
 #include <array>
 #include <functional>
 #include <memory>
+#include <type_traits>
 #if DM_WITH_DEBUGGER
 #include <vector>
 #endif // DM_WITH_DEBUGGER
@@ -79,7 +81,58 @@ struct Joypad
    }
 };
 
-class GameBoy
+// Timers, serial, work RAM and the registers that live on the GameBoy itself, kept in one trivially copyable block so that
+// they can be snapshotted and restored with a plain copy (the components and host callbacks live in GameBoy)
+struct GameBoyState
+{
+   struct SerialControlRegister
+   {
+      bool startTransfer = false;
+      // bool fastSpeed = false; // CGB only
+      bool useInternalClock = false;
+
+      uint8_t read() const;
+      void write(uint8_t value);
+   };
+
+   uint64_t targetCycles = 0;
+   uint64_t totalCycles = 0;
+
+   bool cartWroteToRam = false;
+
+   Joypad joypad;
+   uint8_t lastInputVals = 0x00;
+
+   uint16_t counter = 0;
+   bool timaOverloaded = false;
+   bool ifWritten = false;
+   bool timaReloadedWithTma = false;
+   bool lastTimerBit = false;
+
+   SerialControlRegister serialControlRegister;
+   uint16_t serialCycles = 0;
+
+#if DM_WITH_BOOTSTRAP
+   bool booting = true;
+#endif // DM_WITH_BOOTSTRAP
+
+   std::array<uint8_t, 0x1000> ram0 = {}; // Working RAM bank 0 (0xC000-0xCFFF)
+   std::array<uint8_t, 0x1000> ram1 = {}; // Working RAM bank 1 (0xD000-0xDFFF)
+   std::array<uint8_t, 0x007F> ramh = {}; // High RAM area (0xFF80-0xFFFE)
+
+   uint8_t p1 = 0x00; // Joy pad / system info (0xFF00)
+   uint8_t sb = 0x00; // Serial transfer data (0xFF01)
+   uint8_t tima = 0x00; // Timer counter (0xFF05)
+   uint8_t tma = 0x00; // Timer modulo (0xFF06)
+   uint8_t tac = 0x00; // Timer control (0xFF07)
+
+   uint8_t ifr = 0x00; // Interrupt flag (0xFF0F)
+   uint8_t ie = 0x00; // Interrupt enable register (0xFFFF)
+};
+
+DM_STATIC_ASSERT(std::is_trivially_copyable_v<GameBoyState>, "GameBoy state can't be copied as plain memory!");
+
+class GameBoy : private GameBoyState
 {
 public:
    static const inline uint8_t kInvalidAddressByte = 0xFF;
@@ -92,13 +145,57 @@ public:
    void tick(double dt);
    void machineCycle();
 
+   // Powers the machine off and on again in place, without reallocating anything. The cartridge stays loaded, and keeps
+   // its RAM like it would through a real power cycle (load a snapshot saved at the start instead, for a starting point
+   // that includes it). A bootstrap given to setBootstrap() runs again.
+   void reset();
+
 #if DM_WITH_BOOTSTRAP
    void setBootstrap(std::vector<uint8_t> data);
 #endif // DM_WITH_BOOTSTRAP
 
    void setCartridge(std::unique_ptr<Cartridge> cartridge);
    Archive saveCartRAM() const;
-   bool loadCartRAM(Archive& ram);
+   bool loadCartRAM(ArchiveView& ram);
+
+   // Full machine state, which is always the same size for a given cartridge (so it can be stored in fixed size slots).
+   // Pending LCD lines are drawn and the APU is caught up first, so this isn't const.
+   Archive saveState();
+   void saveState(Archive& state);
+   bool loadState(ArchiveView& state);
+
+   // A savestate without the framebuffers, which are most of a full state and change every frame in most games, for
+   // keeping a long history of states (like for rewinding). Loading one leaves the framebuffers as they are, so they
+   // only show the loaded state once the next frame has been drawn.
+   void saveMachineState(Archive& state);
+   bool loadMachineState(ArchiveView& state);
+
+   // The whole machine as plain copies of each component's state (plus the cartridge's, which varies in size), for
+   // restoring the same instance over and over (run-ahead, rollback, search). Saving into a snapshot that was saved into
+   // before reuses its memory.
+   struct Snapshot
+   {
+      CPUState cpu;
+      LCDControllerState lcdController;
+      SoundControllerState soundController;
+      GameBoyState gameBoy;
+      Archive cart;
+   };
+
+   void saveSnapshot(Snapshot& snapshot);
+   void loadSnapshot(const Snapshot& snapshot);
+
+   // Hash of everything a savestate holds but the framebuffers, for telling states apart without comparing them (replay
+   // checks, desync detection, deduplicating states in a search). Memory is hashed a page at a time, and only the pages
+   // written since the last call are hashed again, so it's cheap enough to call every frame. Memory changed without
+   // going through the emulator (like from a debugger's memory editor) isn't noticed until the page is written again.
+   uint64_t stateHash();
+
+   // A new instance in the same state, for branching off from it (like trying different inputs in parallel). The
+   // cartridge shares its ROM and RAM banks with this one until either side writes to a bank, and the rest of the state
+   // is small enough to copy. Host settings aren't carried over, so the child doesn't generate audio and has no
+   // serial callback. Children can run on other threads, but forking has to happen on the thread this instance runs on.
+   std::unique_ptr<GameBoy> fork();
 
    const char* title() const;
 
@@ -187,6 +284,9 @@ public:
    }
 
 private:
+   void saveState(Archive& state, bool includeFramebuffers);
+   bool loadState(ArchiveView& state, bool includeFramebuffers);
+
    bool shouldStepCPU() const;
 
    void machineCycleJoypad();
@@ -201,61 +301,25 @@ public:
    void writeDirect(uint16_t address, uint8_t value);
 
 private:
-   struct SerialControlRegister
-   {
-      bool startTransfer = false;
-      // bool fastSpeed = false; // CGB only
-      bool useInternalClock = false;
-
-      uint8_t read() const;
-      void write(uint8_t value);
-   };
-
    CPU cpu;
    LCDController lcdController;
    SoundController soundController;
    std::unique_ptr<Cartridge> cart;
 
-   uint64_t targetCycles = 0;
-   uint64_t totalCycles = 0;
-
-   bool cartWroteToRam = false;
-
-   Joypad joypad;
-   uint8_t lastInputVals;
-
-   uint16_t counter = 0;
-   bool timaOverloaded = false;
-   bool ifWritten = false;
-   bool timaReloadedWithTma = false;
-   bool lastTimerBit = false;
-
-   SerialControlRegister serialControlRegister;
-   uint16_t serialCycles = 0;
    SerialCallback serialCallback = nullptr;
 
+   PagedHash<sizeof(ram0)> ram0Hash;
+   PagedHash<sizeof(ram1)> ram1Hash;
+
 #if DM_WITH_BOOTSTRAP
+   // Kept after the bootstrap unmaps itself (which only clears booting), so that reset() can run it again
    std::vector<uint8_t> bootstrap;
-   bool booting = true;
 #endif // DM_WITH_BOOTSTRAP
 
 #if DM_WITH_DEBUGGER
    bool inBreakMode = false;
    std::vector<uint16_t> breakpoints;
 #endif // DM_WITH_DEBUGGER
-
-   std::array<uint8_t, 0x1000> ram0 = {}; // Working RAM bank 0 (0xC000-0xCFFF)
-   std::array<uint8_t, 0x1000> ram1 = {}; // Working RAM bank 1 (0xD000-0xDFFF)
-   std::array<uint8_t, 0x007F> ramh = {}; // High RAM area (0xFF80-0xFFFE)
-
-   uint8_t p1 = 0x00; // Joy pad / system info (0xFF00)
-   uint8_t sb = 0x00; // Serial transfer data (0xFF01)
-   uint8_t tima = 0x00; // Timer counter (0xFF05)
-   uint8_t tma = 0x00; // Timer modulo (0xFF06)
-   uint8_t tac = 0x00; // Timer control (0xFF07)
-
-   uint8_t ifr = 0x00; // Interrupt flag (0xFF0F)
-   uint8_t ie = 0x00; // Interrupt enable register (0xFFFF)
 };
 
 } // namespace DotMatrix
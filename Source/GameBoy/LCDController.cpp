@@ -59,7 +59,7 @@ namespace
    const uint32_t kCyclesPerLine = kSearchOAMCycles + kDataTransferCycles + kHBlankCycles; // 456
 }
 
-uint8_t LCDController::ControlRegister::read() const
+uint8_t LCDControllerState::ControlRegister::read() const
 {
    return lcdDisplayEnabled * LCDC::DisplayEnable
       | windowUseUpperTileMap * LCDC::WindowTileMapDisplaySelect
@@ -71,7 +71,7 @@ uint8_t LCDController::ControlRegister::read() const
       | bgWindowDisplayEnabled * LCDC::BGDisplay;
 }
 
-void LCDController::ControlRegister::write(uint8_t value)
+void LCDControllerState::ControlRegister::write(uint8_t value)
 {
    lcdDisplayEnabled = value & LCDC::DisplayEnable;
    windowUseUpperTileMap = value & LCDC::WindowTileMapDisplaySelect;
@@ -83,7 +83,7 @@ void LCDController::ControlRegister::write(uint8_t value)
    bgWindowDisplayEnabled = value & LCDC::BGDisplay;
 }
 
-uint8_t LCDController::StatusRegister::read() const
+uint8_t LCDControllerState::StatusRegister::read() const
 {
    return 0x80
       | coincidenceInterrupt * STAT::LycLyCoincidence
@@ -94,7 +94,7 @@ uint8_t LCDController::StatusRegister::read() const
       | Enum::cast(mode);
 }
 
-void LCDController::StatusRegister::write(uint8_t value)
+void LCDControllerState::StatusRegister::write(uint8_t value)
 {
    coincidenceInterrupt = value & STAT::LycLyCoincidence;
    oamInterrupt = value & STAT::Mode2OAMInterrupt;
@@ -106,30 +106,178 @@ void LCDController::StatusRegister::write(uint8_t value)
 
 LCDController::LCDController(GameBoy& gb)
    : gameBoy(gb)
-   , modeCyclesRemaining(kCyclesPerLine)
+   , frameMemory(std::make_unique<VideoMemory>())
 {
+   modeCyclesRemaining = kCyclesPerLine;
+
+   // Most frames write to video memory a handful of times at most, so this should rarely need to grow
+   memoryWrites.reserve(1024);
+}
+
+void LCDController::reset()
+{
+   LCDControllerState state;
+   state.modeCyclesRemaining = kCyclesPerLine;
+
+   loadSnapshot(state);
+}
+
+void LCDController::skipBootstrap()
+{
+   controlRegister.write(0x91);
 }
 
 void LCDController::onCPUStopped()
 {
-   // When stopped, fill the screen with white
+   // When stopped, fill the screen with white (lines captured so far this frame would have been drawn underneath)
+   discardPendingLines();
    framebuffers.writeBuffer().fill(0x00);
 }
 
+void LCDController::saveState(Archive& archive, bool includeFramebuffers)
+{
+   renderFrame();
+   discardPendingLines();
+
+   archive.write(modeCyclesRemaining);
+
+   archive.write(dmaRequested);
+   archive.write(dmaPending);
+   archive.write(dmaInProgress);
+   archive.write(dmaIndex);
+   archive.write(dmaSource);
+
+   archive.write(controlRegister.read());
+   archive.write(statusRegister.read());
+
+   archive.write(scy);
+   archive.write(scx);
+   archive.write(ly);
+   archive.write(lyc);
+   archive.write(dma);
+   archive.write(bgp);
+   archive.write(obp0);
+   archive.write(obp1);
+   archive.write(wy);
+   archive.write(wx);
+
+   archive.write(memory.vram);
+   archive.write(memory.oam);
+
+   archive.write(framesUntilRender);
+
+   if (includeFramebuffers)
+   {
+      framebuffers.saveState(archive);
+      archive.write(bgPaletteIndices);
+   }
+}
+
+bool LCDController::loadState(ArchiveView& archive, bool includeFramebuffers)
+{
+   // Nothing captured from the current frame applies to the loaded one
+   discardPendingLines();
+
+   uint8_t lcdc = 0x00;
+   uint8_t stat = 0x00;
+
+   bool loaded = archive.read(modeCyclesRemaining)
+      && archive.read(dmaRequested) && archive.read(dmaPending) && archive.read(dmaInProgress) && archive.read(dmaIndex) && archive.read(dmaSource)
+      && archive.read(lcdc) && archive.read(stat)
+      && archive.read(scy) && archive.read(scx) && archive.read(ly) && archive.read(lyc) && archive.read(dma)
+      && archive.read(bgp) && archive.read(obp0) && archive.read(obp1) && archive.read(wy) && archive.read(wx)
+      && archive.read(memory.vram) && archive.read(memory.oam)
+      && archive.read(framesUntilRender)
+      && (!includeFramebuffers || (framebuffers.loadState(archive) && archive.read(bgPaletteIndices)));
+
+   vramHash.markAllDirty();
+
+   controlRegister.write(lcdc);
+   statusRegister.write(stat);
+   statusRegister.mode = static_cast<Mode>(stat & STAT::ModeFlag);
+
+   return loaded;
+}
+
+void LCDController::hashState(Hasher& hasher)
+{
+   hasher.write(modeCyclesRemaining);
+
+   hasher.write(dmaRequested);
+   hasher.write(dmaPending);
+   hasher.write(dmaInProgress);
+   hasher.write(dmaIndex);
+   hasher.write(dmaSource);
+
+   hasher.write(controlRegister.read());
+   hasher.write(statusRegister.read());
+
+   hasher.write(scy);
+   hasher.write(scx);
+   hasher.write(ly);
+   hasher.write(lyc);
+   hasher.write(dma);
+   hasher.write(bgp);
+   hasher.write(obp0);
+   hasher.write(obp1);
+   hasher.write(wy);
+   hasher.write(wx);
+
+   hasher.write(vramHash.hash(memory.vram.data()));
+   hasher.write(memory.oam);
+
+   hasher.write(framesUntilRender);
+}
+
+void LCDController::saveSnapshot(LCDControllerState& state)
+{
+   // Hidden frames are never drawn, and lines still pending aren't part of the snapshot (loading one discards them), so
+   // they are left to carry on with the frame
+   if (renderingEnabled)
+   {
+      renderFrame();
+      discardPendingLines();
+   }
+
+   state = *this;
+}
+
+void LCDController::loadSnapshot(const LCDControllerState& state)
+{
+   discardPendingLines();
+
+   static_cast<LCDControllerState&>(*this) = state;
+
+   vramHash.markAllDirty();
+}
+
+void LCDController::copyStateFrom(LCDController& other)
+{
+   DM_ASSERT(&other != this);
+
+   other.renderFrame();
+   other.discardPendingLines();
+
+   loadSnapshot(other);
+
+   // Video memory is identical, so the hashes of its pages still hold
+   vramHash = other.vramHash;
+}
+
 uint8_t LCDController::read(uint16_t address) const
 {
    uint8_t value = GameBoy::kInvalidAddressByte;
 
    if (address >= 0x8000 && address <= 0x9FFF)
    {
-      value = vram[address - 0x8000];
+      value = memory.vram[address - 0x8000];
    }
    else if (address >= 0xFE00 && address <= 0xFEFF)
    {
       // Can't read during OAM DMA
       if (isSpriteAttributeTableAccessible())
       {
-         value = oam[address - 0xFE00];
+         value = memory.oam[address - 0xFE00];
       }
    }
    else if (address >= 0xFF40 && address <= 0xFF4F)
@@ -194,14 +342,14 @@ void LCDController::write(uint16_t address, uint8_t value)
 {
    if (address >= 0x8000 && address <= 0x9FFF)
    {
-      vram[address - 0x8000] = value;
+      writeVideoMemory(address - 0x8000, value);
    }
    else if (address >= 0xFE00 && address <= 0xFEFF)
    {
       // Can't write during OAM DMA
       if (isSpriteAttributeTableAccessible())
       {
-         oam[address - 0xFE00] = value;
+         writeVideoMemory(VideoMemory::kOAMOffset + (address - 0xFE00), value);
       }
    }
    else if (address >= 0xFF40 && address <= 0xFF4F)
@@ -209,8 +357,16 @@ void LCDController::write(uint16_t address, uint8_t value)
       switch (address)
       {
       case 0xFF40: // LCD control
+      {
+         bool wasLCDDisplayEnabled = controlRegister.lcdDisplayEnabled;
          controlRegister.write(value);
+
+         if (controlRegister.lcdDisplayEnabled != wasLCDDisplayEnabled)
+         {
+            onLCDDisplayToggled();
+         }
          break;
+      }
       case 0xFF41: // LCD status
          statusRegister.write(value);
          break;
@@ -263,7 +419,8 @@ void LCDController::write(uint16_t address, uint8_t value)
    }
 }
 
-std::array<uint8_t, 4> LCDController::extractPaletteColors(uint8_t palette) const
+// static
+std::array<uint8_t, 4> LCDController::extractPaletteColors(uint8_t palette)
 {
    static const uint8_t kMask = 0x03;
 
@@ -294,7 +451,7 @@ void LCDController::updateDMA()
    {
       if (dmaIndex <= 0x9F)
       {
-         oam[dmaIndex] = gameBoy.readDirect(dmaSource + dmaIndex);
+         writeVideoMemory(VideoMemory::kOAMOffset + dmaIndex, gameBoy.readDirect(dmaSource + dmaIndex));
          ++dmaIndex;
       }
       else
@@ -415,8 +572,23 @@ void LCDController::setMode(Mode newMode)
          gameBoy.requestInterrupt(Interrupt::LCDState);
       }
 
-      framebuffers.flip();
-      bgPaletteIndices.fill(0);
+      if (framesUntilRender == 0)
+      {
+         if (renderingEnabled)
+         {
+            renderFrame();
+            framebuffers.flip();
+            bgPaletteIndices.fill(0);
+         }
+
+         framesUntilRender = frameSkip;
+      }
+      else
+      {
+         --framesUntilRender;
+      }
+
+      discardPendingLines();
       break;
    case Mode::SearchOAM:
       if (statusRegister.oamInterrupt)
@@ -427,7 +599,10 @@ void LCDController::setMode(Mode newMode)
    case Mode::DataTransfer:
       DM_ASSERT(ly < 144);
 
-      scan(framebuffers.writeBuffer(), ly, extractPaletteColors(bgp));
+      if (framesUntilRender == 0)
+      {
+         captureLine();
+      }
       break;
    default:
       DM_ASSERT(false);
@@ -435,37 +610,146 @@ void LCDController::setMode(Mode newMode)
    }
 }
 
-void LCDController::scan(Framebuffer& framebuffer, uint8_t line, const std::array<uint8_t, 4>& paletteColors)
+void LCDController::onLCDDisplayToggled()
 {
+   // Whether turning on or off, the controller starts over from the top of the screen
+   ly = 0;
+
    if (controlRegister.lcdDisplayEnabled)
    {
-      if (controlRegister.bgWindowDisplayEnabled)
-      {
-         scanBackgroundOrWindow<false>(framebuffer, line, paletteColors);
-      }
+      // Mode stepping resumes at the start of line 0
+      statusRegister.mode = Mode::SearchOAM;
+      modeCyclesRemaining = kSearchOAMCycles;
+      updateLYC();
+   }
+   else
+   {
+      // While off, the controller doesn't step at all, so present a single blank frame up front instead of scanning one
+      // every line
+      statusRegister.mode = Mode::HBlank;
+      modeCyclesRemaining = 0;
+
+      discardPendingLines();
+
+      framebuffers.writeBuffer().fill(0x00);
+      framebuffers.flip();
+      bgPaletteIndices.fill(0);
+   }
+}
 
-      if (controlRegister.bgWindowDisplayEnabled && controlRegister.windowDisplayEnabled)
+void LCDController::writeVideoMemory(uint16_t offset, uint8_t value)
+{
+   if (numPendingLines > 0)
+   {
+      if (!frameMemoryCaptured)
       {
-         scanBackgroundOrWindow<true>(framebuffer, line, paletteColors);
+         // Preserve memory as it was for the lines that have already been captured (nothing could have changed it since
+         // the first line of the frame, otherwise it would have been captured then)
+         *frameMemory = memory;
+         frameMemoryCaptured = true;
       }
 
-      if (controlRegister.spriteDisplayEnabled)
+      MemoryWrite memoryWrite;
+      memoryWrite.offset = offset;
+      memoryWrite.value = value;
+      memoryWrites.push_back(memoryWrite);
+   }
+
+   memory.write(offset, value);
+
+   if (offset < VideoMemory::kOAMOffset)
+   {
+      vramHash.markDirty(offset);
+   }
+}
+
+void LCDController::captureLine()
+{
+   if (numPendingLines >= pendingLines.size())
+   {
+      // Only possible if LY was moved back mid-frame
+      return;
+   }
+
+   LineRegisters& registers = pendingLines[numPendingLines++];
+   registers.line = ly;
+   registers.memoryGeneration = static_cast<uint32_t>(memoryWrites.size());
+   registers.lcdc = controlRegister.read();
+   registers.scy = scy;
+   registers.scx = scx;
+   registers.wy = wy;
+   registers.wx = wx;
+   registers.bgp = bgp;
+   registers.obp0 = obp0;
+   registers.obp1 = obp1;
+}
+
+void LCDController::renderFrame()
+{
+   Framebuffer& framebuffer = framebuffers.writeBuffer();
+
+   if (!frameMemoryCaptured)
+   {
+      // Video memory wasn't touched while the frame was being drawn, so every line can be scanned from it directly
+      for (uint8_t i = 0; i < numPendingLines; ++i)
       {
-         scanSprites(framebuffer, line);
+         scan(framebuffer, bgPaletteIndices, memory, pendingLines[i]);
       }
    }
    else
    {
-      size_t lineOffset = line * kScreenWidth;
-      for (size_t x = 0; x < kScreenWidth; ++x)
+      // Replay the logged writes against the copy of memory, catching it up to the state each line was captured in
+      std::size_t writeIndex = 0;
+      for (uint8_t i = 0; i < numPendingLines; ++i)
       {
-         framebuffer[lineOffset + x] = 0x00;
+         const LineRegisters& registers = pendingLines[i];
+         for (; writeIndex < registers.memoryGeneration; ++writeIndex)
+         {
+            frameMemory->write(memoryWrites[writeIndex].offset, memoryWrites[writeIndex].value);
+         }
+
+         scan(framebuffer, bgPaletteIndices, *frameMemory, registers);
       }
    }
 }
 
+void LCDController::discardPendingLines()
+{
+   numPendingLines = 0;
+   frameMemoryCaptured = false;
+   memoryWrites.clear();
+}
+
+// static
+void LCDController::scan(Framebuffer& framebuffer, PaletteIndices& bgPaletteIndices, const VideoMemory& memory, const LineRegisters& registers)
+{
+   uint8_t line = registers.line;
+
+   ControlRegister control;
+   control.write(registers.lcdc);
+
+   // Lines are only captured during data transfer, which only happens while the LCD is on
+   DM_ASSERT(control.lcdDisplayEnabled);
+
+   if (control.bgWindowDisplayEnabled)
+   {
+      scanBackgroundOrWindow<false>(framebuffer, bgPaletteIndices, memory, registers, control, line);
+   }
+
+   if (control.bgWindowDisplayEnabled && control.windowDisplayEnabled)
+   {
+      scanBackgroundOrWindow<true>(framebuffer, bgPaletteIndices, memory, registers, control, line);
+   }
+
+   if (control.spriteDisplayEnabled)
+   {
+      scanSprites(framebuffer, bgPaletteIndices, memory, registers, control, line);
+   }
+}
+
+// static
 template<bool isWindow>
-void LCDController::scanBackgroundOrWindow(Framebuffer& framebuffer, uint8_t line, const std::array<uint8_t, 4>& paletteColors)
+void LCDController::scanBackgroundOrWindow(Framebuffer& framebuffer, PaletteIndices& bgPaletteIndices, const VideoMemory& memory, const LineRegisters& registers, const ControlRegister& control, uint8_t line)
 {
    // 32x32 tiles, 8x8 pixels each
    static const uint16_t kTileWidth = 8;
@@ -473,23 +757,25 @@ void LCDController::scanBackgroundOrWindow(Framebuffer& framebuffer, uint8_t lin
    static const uint16_t kNumTilesPerLine = 32;
    static const uint16_t kWindowXOffset = 7;
 
+   std::array<uint8_t, 4> paletteColors = extractPaletteColors(registers.bgp);
+
    uint8_t y = line;
-   if (isWindow && y < wy)
+   if (isWindow && y < registers.wy)
    {
       // Haven't reached the window yet
       return;
    }
 
-   int16_t yOffset = isWindow ? -wy : scy;
-   int16_t xOffset = isWindow ? (kWindowXOffset - wx) : scx;
+   int16_t yOffset = isWindow ? -registers.wy : registers.scy;
+   int16_t xOffset = isWindow ? (kWindowXOffset - registers.wx) : registers.scx;
 
    uint8_t adjustedY = y + yOffset;
    uint8_t row = adjustedY % kTileHeight;
    uint16_t tileMapYOffset = (adjustedY / kTileHeight) * kNumTilesPerLine;
 
-   bool tileMapDisplaySelect = isWindow ? controlRegister.windowUseUpperTileMap : controlRegister.bgUseUpperTileMap;
+   bool tileMapDisplaySelect = isWindow ? control.windowUseUpperTileMap : control.bgUseUpperTileMap;
    uint16_t tileMapBase = tileMapDisplaySelect ? 0x1C00 : 0x1800;
-   bool signedTileOffset = !controlRegister.bgAndWindowUseUnsignedTileData;
+   bool signedTileOffset = !control.bgAndWindowUseUnsignedTileData;
 
    uint16_t pixelYOffset = kScreenWidth * y;
 
@@ -506,8 +792,8 @@ void LCDController::scanBackgroundOrWindow(Framebuffer& framebuffer, uint8_t lin
       uint8_t col = adjustedX % kTileWidth;
 
       uint16_t tileMapOffset = tileMapXOffset + tileMapYOffset;
-      uint8_t tileNum = vram[tileMapBase + tileMapOffset];
-      TileLine tileLine = fetchTileLine(tileNum, row, signedTileOffset);
+      uint8_t tileNum = memory.vram[tileMapBase + tileMapOffset];
+      TileLine tileLine = fetchTileLine(memory, tileNum, row, signedTileOffset);
 
       for (; col < kTileWidth && x < kScreenWidth; ++col, ++x)
       {
@@ -524,7 +810,8 @@ void LCDController::scanBackgroundOrWindow(Framebuffer& framebuffer, uint8_t lin
    }
 }
 
-void LCDController::scanSprites(Framebuffer& framebuffer, uint8_t line)
+// static
+void LCDController::scanSprites(Framebuffer& framebuffer, const PaletteIndices& bgPaletteIndices, const VideoMemory& memory, const LineRegisters& registers, const ControlRegister& control, uint8_t line)
 {
    static const uint16_t kSpriteWidth = 8;
    static const uint16_t kShortSpriteHeight = 8;
@@ -532,12 +819,12 @@ void LCDController::scanSprites(Framebuffer& framebuffer, uint8_t line)
    static const uint16_t kNumSprites = 40;
 
    uint8_t y = line;
-   uint8_t spriteHeight = controlRegister.useLargeSpriteSize ? kTallSpriteHeight : kShortSpriteHeight;
+   uint8_t spriteHeight = control.useLargeSpriteSize ? kTallSpriteHeight : kShortSpriteHeight;
    uint16_t pixelYOffset = kScreenWidth * y;
 
    for (int8_t sprite = kNumSprites - 1; sprite >= 0; --sprite)
    {
-      SpriteAttributes attributes = spriteAttributes[sprite];
+      SpriteAttributes attributes = memory.spriteAttributes[sprite];
 
       int16_t spriteY = attributes.yPos - kTallSpriteHeight;
       if (spriteY > y || spriteY + spriteHeight <= y
@@ -547,7 +834,7 @@ void LCDController::scanSprites(Framebuffer& framebuffer, uint8_t line)
       }
 
       bool useObp1 = (attributes.flags & Attrib::PaletteNumber) != 0x00;
-      std::array<uint8_t, 4> paletteColors = extractPaletteColors(useObp1 ? obp1 : obp0);
+      std::array<uint8_t, 4> paletteColors = extractPaletteColors(useObp1 ? registers.obp1 : registers.obp0);
 
       uint8_t row = y - spriteY;
       if (attributes.flags & Attrib::YFlip)
@@ -557,7 +844,7 @@ void LCDController::scanSprites(Framebuffer& framebuffer, uint8_t line)
       row %= spriteHeight;
 
       bool flipX = (attributes.flags & Attrib::XFlip) != 0x00;
-      TileLine tileLine = fetchTileLine(attributes.tileNum, row, false);
+      TileLine tileLine = fetchTileLine(memory, attributes.tileNum, row, false);
 
       for (uint8_t col = 0; col < kSpriteWidth; ++col)
       {
@@ -590,7 +877,8 @@ void LCDController::scanSprites(Framebuffer& framebuffer, uint8_t line)
    }
 }
 
-LCDController::TileLine LCDController::fetchTileLine(uint8_t tileNum, uint8_t line, bool signedTileOffset) const
+// static
+LCDController::TileLine LCDController::fetchTileLine(const VideoMemory& memory, uint8_t tileNum, uint8_t line, bool signedTileOffset)
 {
    static const uint8_t kBytesPerTile = 16;
    static const uint8_t kBytesPerLine = 2;
@@ -613,8 +901,8 @@ LCDController::TileLine LCDController::fetchTileLine(uint8_t tileNum, uint8_t li
    uint16_t totalOffset = tileDataBase + tileDataTileOffset + tileDataLineOffset;
 
    TileLine tileLine;
-   tileLine.firstByte = vram[totalOffset];
-   tileLine.secondByte = vram[totalOffset + 1];
+   tileLine.firstByte = memory.vram[totalOffset];
+   tileLine.secondByte = memory.vram[totalOffset + 1];
 
    return tileLine;
 }
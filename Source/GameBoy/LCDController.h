@@ -1,11 +1,16 @@
 #pragma once
 
+#include "Core/Archive.h"
+#include "Core/Assert.h"
 #include "Core/Enum.h"
+#include "Core/Hash.h"
 
 #include <array>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace DotMatrix
 {
@@ -20,22 +25,14 @@ using Framebuffer = std::array<uint8_t, kScreenWidth * kScreenHeight>;
 class DoubleBufferedFramebuffer
 {
 public:
-   DoubleBufferedFramebuffer()
+   Framebuffer& writeBuffer()
    {
-      for (std::size_t i = 0; i < buffers.size(); ++i)
-      {
-         buffers[i] = std::make_unique<Framebuffer>(Framebuffer{});
-      }
-   }
-
-   Framebuffer& writeBuffer() const
-   {
-      return *buffers[writeIndex];
+      return buffers[writeIndex];
    }
 
    const Framebuffer& readBuffer() const
    {
-      return *buffers[!writeIndex];
+      return buffers[!writeIndex];
    }
 
    uint32_t getFrameCounter() const
@@ -49,41 +46,41 @@ public:
       ++frameCounter;
    }
 
-private:
-   std::array<std::unique_ptr<Framebuffer>, 2> buffers;
-   std::size_t writeIndex = 0;
-   uint32_t frameCounter = 0;
-};
-
-class LCDController
-{
-public:
-   LCDController(GameBoy& gb);
-
-   void machineCycle()
+   void saveState(Archive& archive) const
    {
-      updateDMA();
-      updateMode();
-   }
-
-   void onCPUStopped();
-
-   uint8_t read(uint16_t address) const;
-   void write(uint16_t address, uint8_t value);
+      for (const Framebuffer& buffer : buffers)
+      {
+         archive.write(buffer);
+      }
 
-   const Framebuffer& getFramebuffer() const
-   {
-      return framebuffers.readBuffer();
+      archive.write(writeIndex);
+      archive.write(frameCounter);
    }
 
-   uint32_t getFrameCounter() const
+   bool loadState(ArchiveView& archive)
    {
-      return framebuffers.getFrameCounter();
-   }
+      for (Framebuffer& buffer : buffers)
+      {
+         if (!archive.read(buffer))
+         {
+            return false;
+         }
+      }
 
-   std::array<uint8_t, 4> extractPaletteColors(uint8_t palette) const;
+      return archive.read(writeIndex) && writeIndex < buffers.size() && archive.read(frameCounter);
+   }
 
 private:
+   // Held inline (rather than behind pointers) so that the controller's state can be copied as plain memory
+   std::array<Framebuffer, 2> buffers = {};
+   std::size_t writeIndex = 0;
+   uint32_t frameCounter = 0;
+};
+
+// Registers, video memory and the frames drawn from them, kept in one trivially copyable block so that they can be
+// snapshotted and restored with a plain copy (lines waiting to be drawn live in LCDController)
+struct LCDControllerState
+{
    enum class Mode : uint8_t
    {
       HBlank = 0,
@@ -128,30 +125,36 @@ private:
       uint8_t flags = 0;
    };
 
-   struct TileLine
+   struct VideoMemory
    {
-      uint8_t firstByte = 0x00;
-      uint8_t secondByte = 0x00;
-   };
+      static const uint16_t kOAMOffset = 0x2000;
 
-   void updateDMA();
-   void updateMode();
-   void updateLYC();
-   void setMode(Mode newMode);
-
-   void scan(Framebuffer& framebuffer, uint8_t line, const std::array<uint8_t, 4>& paletteColors);
-   template<bool isWindow>
-   void scanBackgroundOrWindow(Framebuffer& framebuffer, uint8_t line, const std::array<uint8_t, 4>& paletteColors);
-   void scanSprites(Framebuffer& framebuffer, uint8_t line);
+      // The union's default member initializer needs a user-provided constructor to apply it
+      VideoMemory()
+      {
+      }
 
-   TileLine fetchTileLine(uint8_t tileNum, uint8_t line, bool signedTileOffset) const;
+      std::array<uint8_t, 0x2000> vram = {};
+      union
+      {
+         std::array<SpriteAttributes, 0x0040> spriteAttributes;
+         std::array<uint8_t, 0x0100> oam = {};
+      };
 
-   bool isSpriteAttributeTableAccessible() const
-   {
-      return dmaIndex == 0x00;
-   }
+      void write(uint16_t offset, uint8_t value)
+      {
+         if (offset < kOAMOffset)
+         {
+            vram[offset] = value;
+         }
+         else
+         {
+            oam[offset - kOAMOffset] = value;
+         }
+      }
+   };
 
-   GameBoy& gameBoy;
+   using PaletteIndices = std::array<uint8_t, kScreenWidth * kScreenHeight>;
 
    uint32_t modeCyclesRemaining = 0;
 
@@ -175,15 +178,152 @@ private:
    uint8_t wy = 0;
    uint8_t wx = 0;
 
-   std::array<uint8_t, 0x2000> vram = {};
-   union
+   VideoMemory memory;
+
+   uint32_t framesUntilRender = 0;
+
+   DoubleBufferedFramebuffer framebuffers;
+   PaletteIndices bgPaletteIndices = {};
+};
+
+DM_STATIC_ASSERT(std::is_trivially_copyable_v<LCDControllerState>, "LCD controller state can't be copied as plain memory!");
+
+class LCDController : private LCDControllerState
+{
+public:
+   LCDController(GameBoy& gb);
+
+   void machineCycle()
+   {
+      updateDMA();
+
+      // While the LCD is off, the controller sits at LY=0 in HBlank, so there is no mode state to step
+      if (controlRegister.lcdDisplayEnabled)
+      {
+         updateMode();
+      }
+   }
+
+   // Back to the power-on state (host settings like frame skip are kept)
+   void reset();
+
+   // Leaves the display the way the bootstrap does when it hands over to the cartridge (LCDC=0x91), for starting without
+   // running one
+   void skipBootstrap();
+
+   void onCPUStopped();
+
+   uint8_t read(uint16_t address) const;
+   void write(uint16_t address, uint8_t value);
+
+   const Framebuffer& getFramebuffer() const
    {
-      std::array<SpriteAttributes, 0x0040> spriteAttributes;
-      std::array<uint8_t, 0x0100> oam = {};
+      return framebuffers.readBuffer();
+   }
+
+   uint32_t getFrameCounter() const
+   {
+      return framebuffers.getFrameCounter();
+   }
+
+   // Number of frames to skip after each rendered frame (0 renders every frame). Skipped frames are neither scanned nor
+   // presented, so the framebuffer keeps showing the last rendered frame.
+   void setFrameSkip(uint32_t skip)
+   {
+      frameSkip = skip;
+   }
+
+   // Frames finished while rendering is disabled are dropped instead of drawn (for frames nobody will see, like
+   // run-ahead's hidden ones). Lines keep being captured, so a frame that finishes after rendering is enabled again is
+   // still drawn whole.
+   void setRenderingEnabled(bool enabled)
+   {
+      renderingEnabled = enabled;
+   }
+
+   static std::array<uint8_t, 4> extractPaletteColors(uint8_t palette);
+
+   // Lines captured so far this frame are drawn before saving, so only the framebuffer needs to be saved for them. Without
+   // the framebuffers, loading leaves them as they are.
+   void saveState(Archive& archive, bool includeFramebuffers);
+   bool loadState(ArchiveView& archive, bool includeFramebuffers);
+
+   // Emulation state, without the framebuffers (which are output rather than state)
+   void hashState(Hasher& hasher);
+
+   // Plain copies of the emulation state, for restoring into the same instance (see GameBoy::Snapshot)
+   void saveSnapshot(LCDControllerState& state);
+   void loadSnapshot(const LCDControllerState& state);
+
+   // Like saving a snapshot of the other controller and loading it, without the copy in between (see GameBoy::fork())
+   void copyStateFrom(LCDController& other);
+
+private:
+   struct TileLine
+   {
+      uint8_t firstByte = 0x00;
+      uint8_t secondByte = 0x00;
    };
 
-   DoubleBufferedFramebuffer framebuffers;
-   std::array<uint8_t, kScreenWidth * kScreenHeight> bgPaletteIndices = {};
+   // Register state that affects how a line is drawn, captured when the line enters data transfer
+   struct LineRegisters
+   {
+      uint32_t memoryGeneration = 0; // Number of logged video memory writes that happened before this line
+      uint8_t line = 0;
+      uint8_t lcdc = 0;
+      uint8_t scy = 0;
+      uint8_t scx = 0;
+      uint8_t wy = 0;
+      uint8_t wx = 0;
+      uint8_t bgp = 0;
+      uint8_t obp0 = 0;
+      uint8_t obp1 = 0;
+   };
+
+   struct MemoryWrite
+   {
+      uint16_t offset = 0; // Relative to the start of VideoMemory
+      uint8_t value = 0;
+   };
+
+   void updateDMA();
+   void updateMode();
+   void updateLYC();
+   void setMode(Mode newMode);
+   void onLCDDisplayToggled();
+
+   void writeVideoMemory(uint16_t offset, uint8_t value);
+   void captureLine();
+   void renderFrame();
+   void discardPendingLines();
+
+   static void scan(Framebuffer& framebuffer, PaletteIndices& bgPaletteIndices, const VideoMemory& memory, const LineRegisters& registers);
+   template<bool isWindow>
+   static void scanBackgroundOrWindow(Framebuffer& framebuffer, PaletteIndices& bgPaletteIndices, const VideoMemory& memory, const LineRegisters& registers, const ControlRegister& control, uint8_t line);
+   static void scanSprites(Framebuffer& framebuffer, const PaletteIndices& bgPaletteIndices, const VideoMemory& memory, const LineRegisters& registers, const ControlRegister& control, uint8_t line);
+
+   static TileLine fetchTileLine(const VideoMemory& memory, uint8_t tileNum, uint8_t line, bool signedTileOffset);
+
+   bool isSpriteAttributeTableAccessible() const
+   {
+      return dmaIndex == 0x00;
+   }
+
+   GameBoy& gameBoy;
+
+   // Lines are rendered all at once when vblank starts, from the register state captured for each line. Video memory
+   // is copied the first time it is written to mid-frame, and the writes are logged so that each line can be drawn
+   // against memory as it was when the line was captured.
+   std::array<LineRegisters, kScreenHeight> pendingLines = {};
+   uint8_t numPendingLines = 0;
+   std::unique_ptr<VideoMemory> frameMemory;
+   bool frameMemoryCaptured = false;
+   std::vector<MemoryWrite> memoryWrites;
+
+   uint32_t frameSkip = 0;
+   bool renderingEnabled = true;
+
+   PagedHash<sizeof(VideoMemory::vram)> vramHash;
 };
 
 } // namespace DotMatrix
@@ -28,6 +28,11 @@ MBCNull::MBCNull(const Cartridge& cartridge)
 {
 }
 
+std::unique_ptr<MemoryBankController> MBCNull::fork(const Cartridge& cartridge) const
+{
+   return forkAs<MBCNull>(cartridge);
+}
+
 uint8_t MBCNull::read(uint16_t address) const
 {
    if (address >= 0x8000)
@@ -35,7 +40,7 @@ uint8_t MBCNull::read(uint16_t address) const
       DM_LOG_WARNING("Trying to read invalid cartridge location: " << Log::hex(address));
    }
 
-   return cart.data(address);
+   return cart->data(address);
 }
 
 void MBCNull::write(uint16_t address, uint8_t value)
@@ -51,6 +56,11 @@ MBC1::MBC1(const Cartridge& cartridge)
 {
 }
 
+std::unique_ptr<MemoryBankController> MBC1::fork(const Cartridge& cartridge) const
+{
+   return forkAs<MBC1>(cartridge);
+}
+
 uint8_t MBC1::read(uint16_t address) const
 {
    uint8_t value = GameBoy::kInvalidAddressByte;
@@ -63,7 +73,7 @@ uint8_t MBC1::read(uint16_t address) const
    case 0x3000:
    {
       // Always contains the first 16Bytes of the ROM
-      value = cart.data(address);
+      value = cart->data(address);
       break;
    }
    case 0x4000:
@@ -73,13 +83,13 @@ uint8_t MBC1::read(uint16_t address) const
    {
       // Switchable ROM bank
       DM_ASSERT(romBankNumber > 0);
-      value = cart.data(address + ((romBankNumber - 1) * 0x4000));
+      value = cart->data(address + ((romBankNumber - 1) * 0x4000));
       break;
    }
    case 0xA000:
    case 0xB000:
    {
-      DM_ASSERT(cart.hasRAM(), "Trying to read from MBC1 cartridge RAM when it doesn't have any!");
+      DM_ASSERT(cart->hasRAM(), "Trying to read from MBC1 cartridge RAM when it doesn't have any!");
 
       // Switchable RAM bank
       if (ramEnabled)
@@ -154,13 +164,13 @@ void MBC1::write(uint16_t address, uint8_t value)
    case 0xA000:
    case 0xB000:
    {
-      DM_ASSERT(cart.hasRAM(), "Trying to write to MBC1 cartridge RAM when it doesn't have any!");
+      DM_ASSERT(cart->hasRAM(), "Trying to write to MBC1 cartridge RAM when it doesn't have any!");
 
       // Switchable RAM bank
       if (ramEnabled)
       {
          uint8_t bankNumber = (bankingMode == BankingMode::RAM) ? ramBankNumber : 0x00;
-         ramBanks[bankNumber][address - 0xA000] = value;
+         ramBanks.write(bankNumber, address - 0xA000, value);
          wroteToRam = true;
       }
       else
@@ -180,26 +190,48 @@ void MBC1::write(uint16_t address, uint8_t value)
 Archive MBC1::saveRAM() const
 {
    Archive ramData;
+   ramData.reserve(ramBanks.kNumBytes);
 
-   for (const RamBank& bank : ramBanks)
-   {
-      ramData.write(bank);
-   }
+   ramBanks.saveState(ramData);
 
    return ramData;
 }
 
-bool MBC1::loadRAM(Archive& ramData)
+bool MBC1::loadRAM(ArchiveView& ramData)
 {
-   for (RamBank& bank : ramBanks)
-   {
-      if (!ramData.read(bank))
-      {
-         return false;
-      }
-   }
+   return ramBanks.loadState(ramData);
+}
 
-   return true;
+void MBC1::reset()
+{
+   ramEnabled = false;
+   romBankNumber = 0x01;
+   ramBankNumber = 0x00;
+   bankingMode = BankingMode::ROM;
+}
+
+void MBC1::saveState(Archive& archive) const
+{
+   archive.write(ramEnabled);
+   archive.write(romBankNumber);
+   archive.write(ramBankNumber);
+   archive.write(bankingMode);
+   ramBanks.saveState(archive);
+}
+
+bool MBC1::loadState(ArchiveView& archive)
+{
+   return archive.read(ramEnabled) && archive.read(romBankNumber) && archive.read(ramBankNumber) && archive.read(bankingMode)
+      && ramBanks.loadState(archive);
+}
+
+void MBC1::hashState(Hasher& hasher)
+{
+   hasher.write(ramEnabled);
+   hasher.write(romBankNumber);
+   hasher.write(ramBankNumber);
+   hasher.write(bankingMode);
+   ramBanks.hashState(hasher);
 }
 
 // MBC2
@@ -210,6 +242,11 @@ MBC2::MBC2(const Cartridge& cartridge)
    ram.fill(0xFF);
 }
 
+std::unique_ptr<MemoryBankController> MBC2::fork(const Cartridge& cartridge) const
+{
+   return forkAs<MBC2>(cartridge);
+}
+
 uint8_t MBC2::read(uint16_t address) const
 {
    uint8_t value = GameBoy::kInvalidAddressByte;
@@ -222,7 +259,7 @@ uint8_t MBC2::read(uint16_t address) const
    case 0x3000:
    {
       // Always contains the first 16Bytes of the ROM
-      value = cart.data(address);
+      value = cart->data(address);
       break;
    }
    case 0x4000:
@@ -232,7 +269,7 @@ uint8_t MBC2::read(uint16_t address) const
    {
       // Switchable ROM bank
       DM_ASSERT(romBankNumber > 0);
-      value = cart.data(address + ((romBankNumber - 1) * 0x4000));
+      value = cart->data(address + ((romBankNumber - 1) * 0x4000));
       break;
    }
    case 0xA000:
@@ -291,7 +328,7 @@ void MBC2::write(uint16_t address, uint8_t value)
    }
    case 0xA000:
    {
-      DM_ASSERT(cart.hasRAM(), "Trying to write to MBC2 cartridge RAM when it doesn't have any!");
+      DM_ASSERT(cart->hasRAM(), "Trying to write to MBC2 cartridge RAM when it doesn't have any!");
       DM_ASSERT(false);
 
       if (address > 0xA1FF)
@@ -329,11 +366,36 @@ Archive MBC2::saveRAM() const
    return ramData;
 }
 
-bool MBC2::loadRAM(Archive& ramData)
+bool MBC2::loadRAM(ArchiveView& ramData)
 {
    return ramData.read(ram);
 }
 
+void MBC2::reset()
+{
+   ramEnabled = false;
+   romBankNumber = 0x01;
+}
+
+void MBC2::saveState(Archive& archive) const
+{
+   archive.write(ramEnabled);
+   archive.write(romBankNumber);
+   archive.write(ram);
+}
+
+bool MBC2::loadState(ArchiveView& archive)
+{
+   return archive.read(ramEnabled) && archive.read(romBankNumber) && archive.read(ram);
+}
+
+void MBC2::hashState(Hasher& hasher)
+{
+   hasher.write(ramEnabled);
+   hasher.write(romBankNumber);
+   hasher.write(ram);
+}
+
 // MBC3
 
 MBC3::MBC3(const Cartridge& cartridge)
@@ -342,6 +404,11 @@ MBC3::MBC3(const Cartridge& cartridge)
    DM_STATIC_ASSERT(sizeof(RTC) == 5, "Invalid RTC size (check bitfields)");
 }
 
+std::unique_ptr<MemoryBankController> MBC3::fork(const Cartridge& cartridge) const
+{
+   return forkAs<MBC3>(cartridge);
+}
+
 uint8_t MBC3::read(uint16_t address) const
 {
    uint8_t value = GameBoy::kInvalidAddressByte;
@@ -354,7 +421,7 @@ uint8_t MBC3::read(uint16_t address) const
    case 0x3000:
    {
       // Always contains the first 16Bytes of the ROM
-      value = cart.data(address);
+      value = cart->data(address);
       break;
    }
    case 0x4000:
@@ -364,13 +431,13 @@ uint8_t MBC3::read(uint16_t address) const
    {
       // Switchable ROM bank
       DM_ASSERT(romBankNumber > 0);
-      value = cart.data(address + ((romBankNumber - 1) * 0x4000));
+      value = cart->data(address + ((romBankNumber - 1) * 0x4000));
       break;
    }
    case 0xA000:
    case 0xB000:
    {
-      DM_ASSERT(cart.hasRAM(), "Trying to read from MBC3 cartridge RAM when it doesn't have any!");
+      DM_ASSERT(cart->hasRAM(), "Trying to read from MBC3 cartridge RAM when it doesn't have any!");
 
       const RTC& readRTC = rtcLatched ? rtcLatchedCopy : rtc;
 
@@ -471,7 +538,7 @@ void MBC3::write(uint16_t address, uint8_t value)
    case 0xA000:
    case 0xB000:
    {
-      DM_ASSERT(cart.hasRAM(), "Trying to write to MBC3 cartridge RAM when it doesn't have any!");
+      DM_ASSERT(cart->hasRAM(), "Trying to write to MBC3 cartridge RAM when it doesn't have any!");
 
       // Switchable RAM bank
       if (ramRTCEnabled)
@@ -482,7 +549,7 @@ void MBC3::write(uint16_t address, uint8_t value)
          case BankRegisterMode::BankOne:
          case BankRegisterMode::BankTwo:
          case BankRegisterMode::BankThree:
-            ramBanks[Enum::cast(bankRegisterMode)][address - 0xA000] = value;
+            ramBanks.write(Enum::cast(bankRegisterMode), address - 0xA000, value);
             break;
          case BankRegisterMode::RTCSeconds:
             rtc.seconds = value;
@@ -556,11 +623,9 @@ void MBC3::tick(double dt)
 Archive MBC3::saveRAM() const
 {
    Archive ramData;
+   ramData.reserve(ramBanks.kNumBytes + sizeof(rtc) + sizeof(int64_t));
 
-   for (const RamBank& bank : ramBanks)
-   {
-      ramData.write(bank);
-   }
+   ramBanks.saveState(ramData);
 
    ramData.write(rtc);
    ramData.write(getPlatformTime());
@@ -568,14 +633,11 @@ Archive MBC3::saveRAM() const
    return ramData;
 }
 
-bool MBC3::loadRAM(Archive& ramData)
+bool MBC3::loadRAM(ArchiveView& ramData)
 {
-   for (RamBank& bank : ramBanks)
+   if (!ramBanks.loadState(ramData))
    {
-      if (!ramData.read(bank))
-      {
-         return false;
-      }
+      return false;
    }
 
    if (!ramData.read(rtc))
@@ -597,6 +659,48 @@ bool MBC3::loadRAM(Archive& ramData)
    return true;
 }
 
+void MBC3::reset()
+{
+   ramRTCEnabled = false;
+   rtcLatched = false;
+   latchData = 0xFF;
+   romBankNumber = 0x01;
+   bankRegisterMode = BankRegisterMode::BankZero;
+}
+
+void MBC3::saveState(Archive& archive) const
+{
+   archive.write(ramRTCEnabled);
+   archive.write(rtcLatched);
+   archive.write(latchData);
+   archive.write(romBankNumber);
+   archive.write(bankRegisterMode);
+   archive.write(rtc);
+   archive.write(rtcLatchedCopy);
+   archive.write(tickTime);
+   ramBanks.saveState(archive);
+}
+
+bool MBC3::loadState(ArchiveView& archive)
+{
+   return archive.read(ramRTCEnabled) && archive.read(rtcLatched) && archive.read(latchData) && archive.read(romBankNumber)
+      && archive.read(bankRegisterMode) && archive.read(rtc) && archive.read(rtcLatchedCopy) && archive.read(tickTime)
+      && ramBanks.loadState(archive);
+}
+
+void MBC3::hashState(Hasher& hasher)
+{
+   hasher.write(ramRTCEnabled);
+   hasher.write(rtcLatched);
+   hasher.write(latchData);
+   hasher.write(romBankNumber);
+   hasher.write(bankRegisterMode);
+   hasher.write(rtc);
+   hasher.write(rtcLatchedCopy);
+   hasher.write(tickTime);
+   ramBanks.hashState(hasher);
+}
+
 // MBC5
 
 MBC5::MBC5(const Cartridge& cartridge)
@@ -604,6 +708,11 @@ MBC5::MBC5(const Cartridge& cartridge)
 {
 }
 
+std::unique_ptr<MemoryBankController> MBC5::fork(const Cartridge& cartridge) const
+{
+   return forkAs<MBC5>(cartridge);
+}
+
 uint8_t MBC5::read(uint16_t address) const
 {
    uint8_t value = GameBoy::kInvalidAddressByte;
@@ -616,7 +725,7 @@ uint8_t MBC5::read(uint16_t address) const
    case 0x3000:
    {
       // Always contains the first 16Bytes of the ROM
-      value = cart.data(address);
+      value = cart->data(address);
       break;
    }
    case 0x4000:
@@ -626,13 +735,13 @@ uint8_t MBC5::read(uint16_t address) const
    {
       // Switchable ROM bank
       DM_ASSERT(romBankNumber <= 0x01E0);
-      value = cart.data(address + ((static_cast<int16_t>(romBankNumber) - 1) * 0x4000));
+      value = cart->data(address + ((static_cast<int16_t>(romBankNumber) - 1) * 0x4000));
       break;
    }
    case 0xA000:
    case 0xB000:
    {
-      DM_ASSERT(cart.hasRAM(), "Trying to read from MBC5 cartridge RAM when it doesn't have any!");
+      DM_ASSERT(cart->hasRAM(), "Trying to read from MBC5 cartridge RAM when it doesn't have any!");
 
       // Switchable RAM bank
       if (ramEnabled)
@@ -688,12 +797,12 @@ void MBC5::write(uint16_t address, uint8_t value)
    case 0xA000:
    case 0xB000:
    {
-      DM_ASSERT(cart.hasRAM(), "Trying to write to MBC5 cartridge RAM when it doesn't have any!");
+      DM_ASSERT(cart->hasRAM(), "Trying to write to MBC5 cartridge RAM when it doesn't have any!");
 
       // Switchable RAM bank
       if (ramEnabled)
       {
-         ramBanks[ramBankNumber][address - 0xA000] = value;
+         ramBanks.write(ramBankNumber, address - 0xA000, value);
          wroteToRam = true;
       }
       else
@@ -713,26 +822,146 @@ void MBC5::write(uint16_t address, uint8_t value)
 Archive MBC5::saveRAM() const
 {
    Archive ramData;
+   ramData.reserve(ramBanks.kNumBytes);
 
-   for (const RamBank& bank : ramBanks)
+   ramBanks.saveState(ramData);
+
+   return ramData;
+}
+
+bool MBC5::loadRAM(ArchiveView& ramData)
+{
+   return ramBanks.loadState(ramData);
+}
+
+void MBC5::reset()
+{
+   ramEnabled = false;
+   romBankNumber = 0x0001;
+   ramBankNumber = 0x00;
+}
+
+void MBC5::saveState(Archive& archive) const
+{
+   archive.write(ramEnabled);
+   archive.write(romBankNumber);
+   archive.write(ramBankNumber);
+   ramBanks.saveState(archive);
+}
+
+bool MBC5::loadState(ArchiveView& archive)
+{
+   return archive.read(ramEnabled) && archive.read(romBankNumber) && archive.read(ramBankNumber) && ramBanks.loadState(archive);
+}
+
+void MBC5::hashState(Hasher& hasher)
+{
+   hasher.write(ramEnabled);
+   hasher.write(romBankNumber);
+   hasher.write(ramBankNumber);
+   ramBanks.hashState(hasher);
+}
+
+// MBCGBS
+
+MBCGBS::MBCGBS(const Cartridge& cartridge)
+   : MemoryBankController(cartridge)
+{
+}
+
+std::unique_ptr<MemoryBankController> MBCGBS::fork(const Cartridge& cartridge) const
+{
+   return forkAs<MBCGBS>(cartridge);
+}
+
+uint8_t MBCGBS::read(uint16_t address) const
+{
+   uint8_t value = GameBoy::kInvalidAddressByte;
+
+   switch (address & 0xF000)
+   {
+   case 0x0000:
+   case 0x1000:
+   case 0x2000:
+   case 0x3000:
    {
-      ramData.write(bank);
+      value = cart->data(address);
+      break;
+   }
+   case 0x4000:
+   case 0x5000:
+   case 0x6000:
+   case 0x7000:
+   {
+      // Switchable ROM bank
+      DM_ASSERT(romBankNumber > 0);
+      value = cart->data(address + ((romBankNumber - 1) * 0x4000));
+      break;
+   }
+   case 0xA000:
+   case 0xB000:
+   {
+      value = ram[address - 0xA000];
+      break;
+   }
+   default:
+   {
+      DM_LOG_WARNING("Trying to read invalid cartridge location: " << Log::hex(address));
+      break;
+   }
    }
 
-   return ramData;
+   return value;
 }
 
-bool MBC5::loadRAM(Archive& ramData)
+void MBCGBS::write(uint16_t address, uint8_t value)
 {
-   for (RamBank& bank : ramBanks)
+   switch (address & 0xF000)
    {
-      if (!ramData.read(bank))
-      {
-         return false;
-      }
+   case 0x2000:
+   case 0x3000:
+   {
+      // ROM bank number (bank 0 is already mapped at 0x0000-0x3FFF, so selecting it selects bank 1 instead)
+      romBankNumber = value == 0x00 ? 0x01 : value;
+      break;
+   }
+   case 0xA000:
+   case 0xB000:
+   {
+      ram[address - 0xA000] = value;
+      ramHash.markDirty(address - 0xA000);
+      break;
    }
+   default:
+   {
+      // Drivers ripped from MBC cartridges can still write to the other banking registers, which don't exist here
+      break;
+   }
+   }
+}
 
-   return true;
+void MBCGBS::reset()
+{
+   romBankNumber = 0x01;
+}
+
+void MBCGBS::saveState(Archive& archive) const
+{
+   archive.write(romBankNumber);
+   archive.write(ram);
+}
+
+bool MBCGBS::loadState(ArchiveView& archive)
+{
+   ramHash.markAllDirty();
+
+   return archive.read(romBankNumber) && archive.read(ram);
+}
+
+void MBCGBS::hashState(Hasher& hasher)
+{
+   hasher.write(romBankNumber);
+   hasher.write(ramHash.hash(ram.data()));
 }
 
 } // namespace DotMatrix
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "Core/Archive.h"
+#include "Core/Hash.h"
 
 #include <array>
 #include <cstdint>
+#include <memory>
 
 namespace DotMatrix
 {
@@ -12,11 +14,107 @@ class Cartridge;
 
 using RamBank = std::array<uint8_t, 0x2000>;
 
+// Switchable cartridge RAM, in banks that are shared with forked cartridges (see Cartridge::fork()) until one of them
+// writes to a bank, which is then copied for the writer. The page hashes used by hashState() go along with each bank.
+//
+// Each instance keeps track of which banks it owns, rather than going by how many instances share a bank, so that forks
+// can run on different threads: a bank is only ever written in place by the one instance that created it, and only
+// until that instance is first copied.
+template<std::size_t kNumBanks>
+class RamBanks
+{
+public:
+   static const inline std::size_t kNumBytes = kNumBanks * sizeof(RamBank);
+
+   RamBanks()
+   {
+      for (std::shared_ptr<RamBank>& bank : banks)
+      {
+         bank = std::make_shared<RamBank>();
+      }
+      ownedBanks.fill(true);
+   }
+
+   // Shares every bank, after which neither instance owns any of them (so both copy a bank the first time they write to
+   // it). The original has to be on the same thread as the copy is made on.
+   RamBanks(const RamBanks& other)
+      : banks(other.banks)
+      , hashes(other.hashes)
+   {
+      other.ownedBanks.fill(false);
+   }
+
+   RamBanks& operator=(const RamBanks& other) = delete;
+
+   const RamBank& operator[](std::size_t index) const
+   {
+      return *banks[index];
+   }
+
+   void write(std::size_t index, uint16_t offset, uint8_t value)
+   {
+      ownBank(index)[offset] = value;
+      hashes[index].markDirty(offset);
+   }
+
+   // For replacing a bank's contents wholesale
+   RamBank& modify(std::size_t index)
+   {
+      hashes[index].markAllDirty();
+      return ownBank(index);
+   }
+
+   void saveState(Archive& archive) const
+   {
+      for (const std::shared_ptr<RamBank>& bank : banks)
+      {
+         archive.write(*bank);
+      }
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      for (std::size_t i = 0; i < kNumBanks; ++i)
+      {
+         if (!archive.read(modify(i)))
+         {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   void hashState(Hasher& hasher)
+   {
+      for (std::size_t i = 0; i < kNumBanks; ++i)
+      {
+         hasher.write(hashes[i].hash(banks[i]->data()));
+      }
+   }
+
+private:
+   RamBank& ownBank(std::size_t index)
+   {
+      if (!ownedBanks[index])
+      {
+         banks[index] = std::make_shared<RamBank>(*banks[index]);
+         ownedBanks[index] = true;
+      }
+
+      return *banks[index];
+   }
+
+   std::array<std::shared_ptr<RamBank>, kNumBanks> banks;
+   std::array<PagedHash<sizeof(RamBank)>, kNumBanks> hashes;
+   mutable std::array<bool, kNumBanks> ownedBanks = {};
+};
+
 class MemoryBankController
 {
 public:
    MemoryBankController(const Cartridge& cartridge)
-      : cart(cartridge)
+      : cart(&cartridge)
    {
    }
 
@@ -25,28 +123,61 @@ public:
    virtual uint8_t read(uint16_t address) const = 0;
    virtual void write(uint16_t address, uint8_t value) = 0;
 
+   // A copy of the controller for a forked cartridge, which shares RAM banks with this one until either writes to them
+   virtual std::unique_ptr<MemoryBankController> fork(const Cartridge& cartridge) const = 0;
+
    virtual void tick(double dt)
    {
       wroteToRam = false;
    }
 
+   // Banking registers go back to their power-on values, while RAM (and the real time clock) is kept like it is through
+   // a real power cycle
+   virtual void reset()
+   {
+   }
+
    virtual Archive saveRAM() const
    {
       return {};
    }
 
-   virtual bool loadRAM(Archive& ramData)
+   virtual bool loadRAM(ArchiveView& ramData)
    {
       return false;
    }
 
+   // Banking registers and RAM (unlike saveRAM(), which is only meant to hold what the cartridge's battery keeps)
+   virtual void saveState(Archive& archive) const
+   {
+   }
+
+   virtual bool loadState(ArchiveView& archive)
+   {
+      return true;
+   }
+
+   // The same state as saveState()
+   virtual void hashState(Hasher& hasher)
+   {
+   }
+
    bool wroteToRamThisFrame() const
    {
       return wroteToRam;
    }
 
 protected:
-   const Cartridge& cart;
+   template<typename T>
+   std::unique_ptr<MemoryBankController> forkAs(const Cartridge& cartridge) const
+   {
+      std::unique_ptr<T> child = std::make_unique<T>(static_cast<const T&>(*this));
+      child->cart = &cartridge;
+
+      return child;
+   }
+
+   const Cartridge* cart = nullptr;
    bool wroteToRam = false;
 };
 
@@ -57,6 +188,8 @@ public:
 
    uint8_t read(uint16_t address) const override;
    void write(uint16_t address, uint8_t value) override;
+
+   std::unique_ptr<MemoryBankController> fork(const Cartridge& cartridge) const override;
 };
 
 class MBC1 : public MemoryBankController
@@ -67,8 +200,16 @@ public:
    uint8_t read(uint16_t address) const override;
    void write(uint16_t address, uint8_t value) override;
 
+   std::unique_ptr<MemoryBankController> fork(const Cartridge& cartridge) const override;
+
+   void reset() override;
+
    Archive saveRAM() const override;
-   bool loadRAM(Archive& ramData) override;
+   bool loadRAM(ArchiveView& ramData) override;
+
+   void saveState(Archive& archive) const override;
+   bool loadState(ArchiveView& archive) override;
+   void hashState(Hasher& hasher) override;
 
 private:
    enum class BankingMode : uint8_t
@@ -82,7 +223,7 @@ private:
    uint8_t ramBankNumber = 0x00;
    BankingMode bankingMode = BankingMode::ROM;
 
-   std::array<RamBank, 4> ramBanks = {};
+   RamBanks<4> ramBanks;
 };
 
 class MBC2 : public MemoryBankController
@@ -93,8 +234,16 @@ public:
    uint8_t read(uint16_t address) const override;
    void write(uint16_t address, uint8_t value) override;
 
+   std::unique_ptr<MemoryBankController> fork(const Cartridge& cartridge) const override;
+
+   void reset() override;
+
    Archive saveRAM() const override;
-   bool loadRAM(Archive& ramData) override;
+   bool loadRAM(ArchiveView& ramData) override;
+
+   void saveState(Archive& archive) const override;
+   bool loadState(ArchiveView& archive) override;
+   void hashState(Hasher& hasher) override;
 
 private:
    bool ramEnabled = false;
@@ -111,10 +260,18 @@ public:
    uint8_t read(uint16_t address) const override;
    void write(uint16_t address, uint8_t value) override;
 
+   std::unique_ptr<MemoryBankController> fork(const Cartridge& cartridge) const override;
+
+   void reset() override;
+
    void tick(double dt) override;
 
    Archive saveRAM() const override;
-   bool loadRAM(Archive& ramData) override;
+   bool loadRAM(ArchiveView& ramData) override;
+
+   void saveState(Archive& archive) const override;
+   bool loadState(ArchiveView& archive) override;
+   void hashState(Hasher& hasher) override;
 
    enum class BankRegisterMode : uint8_t
    {
@@ -159,7 +316,7 @@ private:
    RTC rtcLatchedCopy;
    double tickTime = 0.0;
 
-   std::array<RamBank, 4> ramBanks = {};
+   RamBanks<4> ramBanks;
 };
 
 class MBC5 : public MemoryBankController
@@ -170,15 +327,47 @@ public:
    uint8_t read(uint16_t address) const override;
    void write(uint16_t address, uint8_t value) override;
 
+   std::unique_ptr<MemoryBankController> fork(const Cartridge& cartridge) const override;
+
+   void reset() override;
+
    Archive saveRAM() const override;
-   bool loadRAM(Archive& ramData) override;
+   bool loadRAM(ArchiveView& ramData) override;
+
+   void saveState(Archive& archive) const override;
+   bool loadState(ArchiveView& archive) override;
+   void hashState(Hasher& hasher) override;
 
 private:
    bool ramEnabled = false;
    uint16_t romBankNumber = 0x0001;
    uint8_t ramBankNumber = 0x00;
 
-   std::array<RamBank, 16> ramBanks = {};
+   RamBanks<16> ramBanks;
+};
+
+// Banking used by GBS sound drivers: any write to 0x2000-0x3FFF selects the switchable ROM bank, and RAM is always enabled
+class MBCGBS : public MemoryBankController
+{
+public:
+   MBCGBS(const Cartridge& cartridge);
+
+   uint8_t read(uint16_t address) const override;
+   void write(uint16_t address, uint8_t value) override;
+
+   std::unique_ptr<MemoryBankController> fork(const Cartridge& cartridge) const override;
+
+   void reset() override;
+
+   void saveState(Archive& archive) const override;
+   bool loadState(ArchiveView& archive) override;
+   void hashState(Hasher& hasher) override;
+
+private:
+   uint8_t romBankNumber = 0x01;
+
+   RamBank ram = {};
+   PagedHash<sizeof(ram)> ramHash;
 };
 
 } // namespace DotMatrix
@@ -0,0 +1,163 @@
+#include "Core/Assert.h"
+
+#include "GameBoy/Resampler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace DotMatrix
+{
+
+namespace
+{
+   // Just below Nyquist, as a fraction of the lower of the two sample rates
+   const double kCutoff = 0.45;
+
+   // Enough input samples to reserve for a frame's worth of audio without reallocating
+   const std::size_t kReserveSamples = 4096;
+}
+
+Resampler::Resampler(uint32_t inputSampleRate, uint32_t outputSampleRate)
+   : sampleRate(outputSampleRate)
+   , step((static_cast<uint64_t>(inputSampleRate) << kTimeBits) / outputSampleRate)
+   , kernel(getKernel(inputSampleRate, outputSampleRate))
+{
+   input.reserve(kReserveSamples);
+   clear();
+}
+
+// static
+std::shared_ptr<const std::vector<float>> Resampler::getKernel(uint32_t inputSampleRate, uint32_t outputSampleRate)
+{
+   // Kernels take a while to generate and only depend on the sample rates, so every resampler converting between the
+   // same rates shares one (instances are created often, e.g. whenever a GameBoy is forked)
+   static std::mutex mutex;
+   static std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<const std::vector<float>>> kernels;
+
+   std::lock_guard<std::mutex> lock(mutex);
+
+   std::shared_ptr<const std::vector<float>>& kernel = kernels[std::make_pair(inputSampleRate, outputSampleRate)];
+   if (!kernel)
+   {
+      kernel = std::make_shared<const std::vector<float>>(generateKernel(inputSampleRate, outputSampleRate));
+   }
+
+   return kernel;
+}
+
+// static
+std::vector<float> Resampler::generateKernel(uint32_t inputSampleRate, uint32_t outputSampleRate)
+{
+   DM_ASSERT(inputSampleRate > 0 && outputSampleRate > 0);
+
+   static const double kPi = 3.14159265358979323846;
+   static const double kHalfWidth = kNumTaps / 2;
+
+   std::vector<float> kernel(kNumPhases * kNumTaps);
+
+   // Cutoff in cycles per input sample (when downsampling, everything above the output's Nyquist frequency has to go)
+   const double cutoff = kCutoff * std::min(inputSampleRate, outputSampleRate) / inputSampleRate;
+
+   for (std::size_t phase = 0; phase < kNumPhases; ++phase)
+   {
+      float* taps = &kernel[phase * kNumTaps];
+      double sum = 0.0;
+
+      for (std::size_t tap = 0; tap < kNumTaps; ++tap)
+      {
+         // Distance (in input samples) from the output sample, which sits phase / kNumPhases past the middle of the window
+         double t = static_cast<double>(tap) - (kHalfWidth - 1.0) - static_cast<double>(phase) / kNumPhases;
+
+         double x = 2.0 * cutoff * t;
+         double sinc = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+         double window = 0.42 + 0.5 * std::cos(kPi * t / kHalfWidth) + 0.08 * std::cos(2.0 * kPi * t / kHalfWidth);
+
+         taps[tap] = static_cast<float>(sinc * window);
+         sum += taps[tap];
+      }
+
+      // Normalize each phase so that a constant input passes through unchanged
+      for (std::size_t tap = 0; tap < kNumTaps; ++tap)
+      {
+         taps[tap] = static_cast<float>(taps[tap] / sum);
+      }
+   }
+
+   return kernel;
+}
+
+std::size_t Resampler::samplesAvailable() const
+{
+   if (input.size() < kNumTaps)
+   {
+      return 0;
+   }
+
+   // Every output sample whose window starts before this has all of its input
+   uint64_t limit = static_cast<uint64_t>(input.size() - kNumTaps + 1) << kTimeBits;
+   if (position >= limit)
+   {
+      return 0;
+   }
+
+   return static_cast<std::size_t>((limit - position + step - 1) / step);
+}
+
+std::size_t Resampler::readSamples(int16_t* samples, std::size_t maxSamples, std::size_t stride)
+{
+   static const std::size_t kNumLanes = 8;
+   DM_STATIC_ASSERT(kNumTaps % kNumLanes == 0, "Number of taps must be a multiple of the number of lanes");
+
+   std::size_t numSamples = std::min(maxSamples, samplesAvailable());
+   const float* filters = kernel->data();
+
+   for (std::size_t i = 0; i < numSamples; ++i)
+   {
+      const float* window = &input[static_cast<std::size_t>(position >> kTimeBits)];
+      const float* taps = &filters[((position >> (kTimeBits - kPhaseBits)) & (kNumPhases - 1)) * kNumTaps];
+
+      // Independent partial sums let the compiler vectorize the dot product without reordering any floating point math
+      std::array<float, kNumLanes> sums = {};
+      for (std::size_t tap = 0; tap < kNumTaps; tap += kNumLanes)
+      {
+         for (std::size_t lane = 0; lane < kNumLanes; ++lane)
+         {
+            sums[lane] += window[tap + lane] * taps[tap + lane];
+         }
+      }
+
+      float sum = 0.0f;
+      for (float partialSum : sums)
+      {
+         sum += partialSum;
+      }
+
+      long sample = std::lround(sum);
+      sample = std::clamp<long>(sample, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+      samples[i * stride] = static_cast<int16_t>(sample);
+
+      position += step;
+   }
+
+   // Drop the input that no future output sample will need
+   std::size_t numConsumed = static_cast<std::size_t>(position >> kTimeBits);
+   DM_ASSERT(numConsumed <= input.size());
+   input.erase(input.begin(), input.begin() + numConsumed);
+   position -= static_cast<uint64_t>(numConsumed) << kTimeBits;
+
+   return numSamples;
+}
+
+void Resampler::clear()
+{
+   // Start with half a window of silence, so the first output sample lines up with the first input sample
+   position = 0;
+   input.assign(kNumTaps / 2 - 1, 0.0f);
+}
+
+} // namespace DotMatrix
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace DotMatrix
+{
+
+// Converts a stream of samples from one sample rate to another with a polyphase windowed sinc filter
+//
+// Samples are written one at a time at the input rate, and read in bulk at the output rate. Each output sample is a dot
+// product of the surrounding input samples with one of kNumPhases precomputed filters (picked by the fractional position
+// of the output sample between two input samples).
+class Resampler
+{
+public:
+   Resampler(uint32_t inputSampleRate, uint32_t outputSampleRate);
+
+   uint32_t getSampleRate() const
+   {
+      return sampleRate;
+   }
+
+   void write(int16_t sample)
+   {
+      input.push_back(sample);
+   }
+
+   // Number of input samples held (including those kept around for upcoming output samples)
+   std::size_t inputSize() const
+   {
+      return input.size();
+   }
+
+   std::size_t samplesAvailable() const;
+
+   // Writes up to maxSamples samples, each stride int16_t values apart, and returns the number written
+   std::size_t readSamples(int16_t* samples, std::size_t maxSamples, std::size_t stride);
+
+   void clear();
+
+private:
+   static const uint32_t kTimeBits = 32;
+   static const uint32_t kPhaseBits = 8;
+   static const uint32_t kNumPhases = 1 << kPhaseBits;
+   static const std::size_t kNumTaps = 32;
+
+   static std::shared_ptr<const std::vector<float>> getKernel(uint32_t inputSampleRate, uint32_t outputSampleRate);
+   static std::vector<float> generateKernel(uint32_t inputSampleRate, uint32_t outputSampleRate);
+
+   uint32_t sampleRate = 0;
+   uint64_t step = 0; // Input samples per output sample, with kTimeBits of fraction
+   uint64_t position = 0; // Start of the next output sample's filter window in the input, with kTimeBits of fraction
+   std::shared_ptr<const std::vector<float>> kernel; // kNumPhases filters of kNumTaps taps each
+   std::vector<float> input;
+};
+
+} // namespace DotMatrix
@@ -0,0 +1,128 @@
+#include "GameBoy/RomImage.h"
+
+#include <filesystem>
+#include <utility>
+
+#ifdef _WIN32
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif // _WIN32
+
+namespace DotMatrix
+{
+
+namespace
+{
+#ifdef _WIN32
+   const uint8_t* mapFile(const std::string& path, std::size_t& size)
+   {
+      HANDLE file = CreateFileW(std::filesystem::u8path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+      {
+         return nullptr;
+      }
+
+      const uint8_t* data = nullptr;
+
+      LARGE_INTEGER fileSize = {};
+      if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+      {
+         // The view keeps the mapping (and the file) open, so neither handle is needed once it exists
+         if (HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr))
+         {
+            data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            size = static_cast<std::size_t>(fileSize.QuadPart);
+
+            CloseHandle(mapping);
+         }
+      }
+
+      CloseHandle(file);
+
+      return data;
+   }
+
+   void unmapFile(const uint8_t* data, std::size_t)
+   {
+      // Views are always unmapped whole
+      UnmapViewOfFile(data);
+   }
+#else
+   const uint8_t* mapFile(const std::string& path, std::size_t& size)
+   {
+      int file = open(path.c_str(), O_RDONLY);
+      if (file < 0)
+      {
+         return nullptr;
+      }
+
+      const uint8_t* data = nullptr;
+
+      struct stat fileStatus;
+      if (fstat(file, &fileStatus) == 0 && fileStatus.st_size > 0)
+      {
+         // The mapping keeps the file open, so the descriptor isn't needed once it exists
+         void* mapping = mmap(nullptr, static_cast<std::size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+         if (mapping != MAP_FAILED)
+         {
+            data = static_cast<const uint8_t*>(mapping);
+            size = static_cast<std::size_t>(fileStatus.st_size);
+         }
+      }
+
+      close(file);
+
+      return data;
+   }
+
+   void unmapFile(const uint8_t* data, std::size_t size)
+   {
+      munmap(const_cast<uint8_t*>(data), size);
+   }
+#endif // _WIN32
+}
+
+// static
+std::shared_ptr<const RomImage> RomImage::fromData(std::vector<uint8_t> data)
+{
+   std::shared_ptr<RomImage> image(new RomImage);
+
+   image->ownedData = std::move(data);
+   image->bytes = image->ownedData.data();
+   image->numBytes = image->ownedData.size();
+
+   return image;
+}
+
+// static
+std::shared_ptr<const RomImage> RomImage::fromFile(const std::string& path)
+{
+   std::size_t size = 0;
+   const uint8_t* data = mapFile(path, size);
+   if (!data)
+   {
+      return nullptr;
+   }
+
+   std::shared_ptr<RomImage> image(new RomImage);
+
+   image->mapped = true;
+   image->bytes = data;
+   image->numBytes = size;
+
+   return image;
+}
+
+RomImage::~RomImage()
+{
+   if (mapped)
+   {
+      unmapFile(bytes, numBytes);
+   }
+}
+
+} // namespace DotMatrix
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace DotMatrix
+{
+
+// Read only ROM data, which cartridges hold by reference count so that any number of instances running the same game
+// share one copy of it (only banking state and RAM belong to each cartridge)
+//
+// The data can be owned by the image or mapped from a file, neither of which involve copying it.
+class RomImage
+{
+public:
+   static std::shared_ptr<const RomImage> fromData(std::vector<uint8_t> data);
+
+   // Maps the file in read only, so that loading is the same cost no matter the size of the ROM (pages are only read in
+   // as they are accessed). The path is UTF-8 (like std::filesystem::path::u8string() gives), and the file must not be
+   // truncated while the image is alive. Returns null if the file can't be mapped.
+   static std::shared_ptr<const RomImage> fromFile(const std::string& path);
+
+   RomImage(const RomImage& other) = delete;
+   RomImage& operator=(const RomImage& other) = delete;
+
+   ~RomImage();
+
+   const uint8_t* data() const
+   {
+      return bytes;
+   }
+
+   std::size_t size() const
+   {
+      return numBytes;
+   }
+
+private:
+   RomImage() = default;
+
+   std::vector<uint8_t> ownedData;
+   bool mapped = false;
+
+   const uint8_t* bytes = nullptr;
+   std::size_t numBytes = 0;
+};
+
+} // namespace DotMatrix
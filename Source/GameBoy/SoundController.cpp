@@ -1,12 +1,153 @@
+#include "GameBoy/AudioCapture.h"
 #include "GameBoy/CPU.h"
 #include "GameBoy/GameBoy.h"
 #include "GameBoy/SoundController.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 namespace DotMatrix
 {
 
+namespace
+{
+   const uint32_t kCyclesPerSample = CPU::kClockSpeed / SoundController::kSampleRate;
+   DM_STATIC_ASSERT(CPU::kClockSpeed % SoundController::kSampleRate == 0, "Sample rate does not divide evenly into the CPU clock speed!");
+
+   // Longest span stepped through at once (keeps the pending machine cycle count well away from overflowing)
+   const uint32_t kMaxSpanCycles = CPU::kClockSpeed;
+
+   // How often band-limited samples are flushed to the output buffer (roughly a millisecond's worth)
+   const uint32_t kBandLimitedFrameCycles = 4096;
+
+   // How much generated audio can be held until it is read
+   const double kDefaultAudioBufferDuration = 0.125;
+
+   std::size_t samplesForDuration(uint32_t sampleRate, double seconds)
+   {
+      return static_cast<std::size_t>(std::ceil(sampleRate * seconds));
+   }
+
+   // Moves all of the available samples from a pair of left / right sample sources into the interleaved output buffer
+   template<typename SampleSource>
+   void transferSamples(SampleSource& leftSource, SampleSource& rightSource, RingBuffer<AudioSample>& buffer)
+   {
+      static const std::size_t kStride = sizeof(AudioSample) / sizeof(int16_t);
+
+      DM_ASSERT(leftSource.samplesAvailable() == rightSource.samplesAvailable());
+      std::size_t numSamples = leftSource.samplesAvailable();
+
+      while (numSamples > 0)
+      {
+         // The write space ends where the buffer wraps around, so this takes at most two passes
+         std::size_t space = 0;
+         AudioSample* samples = buffer.getWriteSpace(space);
+         std::size_t numToWrite = std::min(numSamples, space);
+
+         leftSource.readSamples(&samples->left, numToWrite, kStride);
+         rightSource.readSamples(&samples->right, numToWrite, kStride);
+         buffer.commit(numToWrite);
+
+         numSamples -= numToWrite;
+      }
+   }
+
+   uint16_t stepLFSR(uint16_t lfsr, bool widthMode)
+   {
+      uint8_t bit0 = lfsr & 0x01;
+      lfsr >>= 1;
+      uint8_t bit1 = lfsr & 0x01;
+      uint8_t xorResult = bit0 ^ bit1;
+
+      lfsr = (lfsr & 0b1011111111111111) | (xorResult << 14);
+      if (widthMode)
+      {
+         lfsr = (lfsr & 0b1111111110111111) | (xorResult << 6);
+      }
+
+      return lfsr;
+   }
+
+   bool isLFSRHigh(uint16_t lfsr)
+   {
+      return (lfsr & 0x0001) == 0x00;
+   }
+
+   // Every state a settled LFSR steps through in one of its modes (in order), so it can jump ahead any number of steps
+   //
+   // The 15-bit register has a period of 32767 and the 7-bit one a period of 127. Once settled, the bits above the 7-bit
+   // register are determined by the bits in it, so both sequences can be indexed by the bits that take part in the cycle.
+   class LFSRSequence
+   {
+   public:
+      LFSRSequence(bool widthMode)
+         : keyMask(widthMode ? 0x007F : 0x7FFF)
+         , length(keyMask)
+         , states(length)
+         , indices(keyMask + 1)
+         , highCounts(length + 1)
+      {
+         uint16_t lfsr = 0xFFFF;
+         for (uint8_t i = 0; i < LFSRUnit::kSettleSteps; ++i)
+         {
+            lfsr = stepLFSR(lfsr, widthMode);
+         }
+
+         for (uint16_t i = 0; i < length; ++i)
+         {
+            states[i] = lfsr;
+            indices[lfsr & keyMask] = i;
+            highCounts[i + 1] = highCounts[i] + (isLFSRHigh(lfsr) ? 1 : 0);
+
+            lfsr = stepLFSR(lfsr, widthMode);
+         }
+
+         DM_ASSERT(lfsr == states[0], "LFSR sequence is not maximal length");
+      }
+
+      // Returns the state of a settled register after numSteps steps, and counts the high states stepped through
+      uint16_t jump(uint16_t lfsr, uint32_t numSteps, uint32_t& numHighStates) const
+      {
+         uint16_t key = lfsr & keyMask;
+         if (key == 0)
+         {
+            // A register cleared by switching modes at the wrong time is stuck at zero (which is high)
+            DM_ASSERT(lfsr == 0);
+            numHighStates = numSteps;
+            return lfsr;
+         }
+
+         uint16_t index = indices[key];
+         DM_ASSERT(states[index] == lfsr);
+
+         // The states stepped through are the ones following index
+         uint16_t start = (index + 1) % length;
+         uint16_t numPartialSteps = numSteps % length;
+         uint32_t end = start + numPartialSteps;
+
+         numHighStates = (numSteps / length) * highCounts[length];
+         if (end <= length)
+         {
+            numHighStates += highCounts[end] - highCounts[start];
+         }
+         else
+         {
+            numHighStates += (highCounts[length] - highCounts[start]) + highCounts[end - length];
+         }
+
+         return states[(index + numPartialSteps) % length];
+      }
+
+   private:
+      const uint16_t keyMask;
+      const uint16_t length;
+      std::vector<uint16_t> states;
+      std::vector<uint16_t> indices;
+      std::vector<uint16_t> highCounts;
+   };
+}
+
 void EnvelopeUnit::clock()
 {
    DM_ASSERT(counter > 0);
@@ -31,7 +172,7 @@ void EnvelopeUnit::clock()
    }
 }
 
-void SweepUnit::clock()
+void SweepUnit::clock(SquareWaveChannel& channel)
 {
    DM_ASSERT(counter > 0);
    --counter;
@@ -42,20 +183,20 @@ void SweepUnit::clock()
 
       if (enabled && period != 0)
       {
-         uint16_t newFrequency = calculateNewFrequency();
+         uint16_t newFrequency = calculateNewFrequency(channel);
 
          if (newFrequency < 2048 && shift != 0)
          {
             shadowFrequency = newFrequency;
-            owner.setFrequency(newFrequency);
+            channel.setFrequency(newFrequency);
 
-            calculateNewFrequency();
+            calculateNewFrequency(channel);
          }
       }
    }
 }
 
-uint16_t SweepUnit::calculateNewFrequency()
+uint16_t SweepUnit::calculateNewFrequency(SquareWaveChannel& channel)
 {
    uint16_t newFrequency = shadowFrequency >> shift;
 
@@ -70,7 +211,7 @@ uint16_t SweepUnit::calculateNewFrequency()
 
    if (newFrequency >= 2048)
    {
-      owner.disable();
+      channel.disable();
    }
 
    return newFrequency;
@@ -89,24 +230,36 @@ int8_t WaveUnit::getCurrentAudioSample() const
    return (shiftedSample - 0x08);
 }
 
-void LFSRUnit::clock()
+uint32_t LFSRUnit::clock(uint32_t numClocks)
 {
-   uint8_t bit0 = lfsr & 0x01;
-   lfsr >>= 1;
-   uint8_t bit1 = lfsr & 0x01;
-   uint8_t xorResult = bit0 ^ bit1;
+   DM_ASSERT(numClocks > 0);
+
+   uint32_t numHighStates = 0;
 
-   lfsr = (lfsr & 0b1011111111111111) | (xorResult << 14);
-   if (widthMode)
+   // Step one at a time until the register has settled into its cycle
+   uint32_t numSingleSteps = std::min<uint32_t>(numClocks, stepsUntilSettled);
+   for (uint32_t i = 0; i < numSingleSteps; ++i)
    {
-      lfsr = (lfsr & 0b1111111110111111) | (xorResult << 6);
+      lfsr = stepLFSR(lfsr, widthMode);
+      numHighStates += isHigh() ? 1 : 0;
    }
+   stepsUntilSettled -= static_cast<uint8_t>(numSingleSteps);
+
+   if (numClocks > numSingleSteps)
+   {
+      static const LFSRSequence kSequence(false);
+      static const LFSRSequence kWidthModeSequence(true);
+
+      uint32_t numJumpedHighStates = 0;
+      lfsr = (widthMode ? kWidthModeSequence : kSequence).jump(lfsr, numClocks - numSingleSteps, numJumpedHighStates);
+      numHighStates += numJumpedHighStates;
+   }
+
+   return numHighStates;
 }
 
 SquareWaveChannel::SquareWaveChannel()
-   : timer(*this)
-   , lengthUnit(*this, 64)
-   , sweepUnit(*this)
+   : lengthUnit(64)
 {
 }
 
@@ -189,6 +342,12 @@ void SquareWaveChannel::write(uint16_t address, uint8_t value)
    case 0xFF17:
       // Starting volume, Envelope add mode, period
       envelopeUnit.writeNrx2(value);
+
+      // Turning the DAC off also disables the channel (until it is triggered again)
+      if (!envelopeUnit.isDacPowered())
+      {
+         disable();
+      }
       break;
    case 0xFF13:
    case 0xFF18:
@@ -213,9 +372,26 @@ void SquareWaveChannel::write(uint16_t address, uint8_t value)
    }
 }
 
+void SquareWaveChannel::saveState(Archive& archive) const
+{
+   SoundChannel::saveState(archive);
+   timer.saveState(archive);
+   archive.write(frequency);
+
+   dutyUnit.saveState(archive);
+   lengthUnit.saveState(archive);
+   envelopeUnit.saveState(archive);
+   sweepUnit.saveState(archive);
+}
+
+bool SquareWaveChannel::loadState(ArchiveView& archive)
+{
+   return SoundChannel::loadState(archive) && timer.loadState(archive) && archive.read(frequency)
+      && dutyUnit.loadState(archive) && lengthUnit.loadState(archive) && envelopeUnit.loadState(archive) && sweepUnit.loadState(archive);
+}
+
 WaveChannel::WaveChannel()
-   : timer(*this)
-   , lengthUnit(*this, 256)
+   : lengthUnit(256)
 {
 }
 
@@ -285,6 +461,12 @@ void WaveChannel::write(uint16_t address, uint8_t value)
    case 0xFF1A:
       // DAC power
       waveUnit.writeNrx0(value);
+
+      // Turning the DAC off also disables the channel (until it is triggered again)
+      if (!waveUnit.isDacPowered())
+      {
+         disable();
+      }
       break;
    case 0xFF1B:
       // Length load (256-L)
@@ -322,9 +504,24 @@ void WaveChannel::write(uint16_t address, uint8_t value)
    }
 }
 
+void WaveChannel::saveState(Archive& archive) const
+{
+   SoundChannel::saveState(archive);
+   timer.saveState(archive);
+   archive.write(frequency);
+
+   waveUnit.saveState(archive);
+   lengthUnit.saveState(archive);
+}
+
+bool WaveChannel::loadState(ArchiveView& archive)
+{
+   return SoundChannel::loadState(archive) && timer.loadState(archive) && archive.read(frequency)
+      && waveUnit.loadState(archive) && lengthUnit.loadState(archive);
+}
+
 NoiseChannel::NoiseChannel()
-   : timer(*this)
-   , lengthUnit(*this, 64)
+   : lengthUnit(64)
 {
 }
 
@@ -341,6 +538,30 @@ int8_t NoiseChannel::getCurrentAudioSample() const
    return sample;
 }
 
+int8_t NoiseChannel::getAveragedAudioSample() const
+{
+   if (!isEnabled() || averagedCycles == 0)
+   {
+      return getCurrentAudioSample();
+   }
+
+   // Maps the fraction of time spent high onto [-volume, volume]
+   int32_t volume = envelopeUnit.getVolume();
+   int32_t highMinusLowCycles = 2 * static_cast<int32_t>(averagedHighCycles) - static_cast<int32_t>(averagedCycles);
+
+   return static_cast<int8_t>(std::lround(static_cast<double>(volume * highMinusLowCycles) / averagedCycles));
+}
+
+void NoiseChannel::clock(uint32_t numClocks)
+{
+   uint32_t numHighStates = lfsrUnit.clock(numClocks);
+
+   // Every state but the newest lasted a whole timer period, and the newest one has lasted until now
+   uint32_t period = timer.getPeriod();
+   uint32_t newestHigh = lfsrUnit.isHigh() ? 1 : 0;
+   averagedHighCycles += (numHighStates - newestHigh) * period + newestHigh * (period - timer.cyclesUntilClock());
+}
+
 uint8_t NoiseChannel::read(uint16_t address) const
 {
    uint8_t value = 0x00;
@@ -386,6 +607,12 @@ void NoiseChannel::write(uint16_t address, uint8_t value)
    case 0xFF21:
       // Starting volume, Envelope add mode, period
       envelopeUnit.writeNrx2(value);
+
+      // Turning the DAC off also disables the channel (until it is triggered again)
+      if (!envelopeUnit.isDacPowered())
+      {
+         disable();
+      }
       break;
    case 0xFF22:
       // Clock shift, Width mode of LFSR, Divisor code
@@ -407,36 +634,59 @@ void NoiseChannel::write(uint16_t address, uint8_t value)
    }
 }
 
-void FrameSequencer::clock()
+void NoiseChannel::saveState(Archive& archive) const
+{
+   SoundChannel::saveState(archive);
+   timer.saveState(archive);
+
+   lfsrUnit.saveState(archive);
+   lengthUnit.saveState(archive);
+   envelopeUnit.saveState(archive);
+
+   archive.write(averagedCycles);
+   archive.write(averagedHighCycles);
+}
+
+bool NoiseChannel::loadState(ArchiveView& archive)
 {
-   switch (step)
+   return SoundChannel::loadState(archive) && timer.loadState(archive)
+      && lfsrUnit.loadState(archive) && lengthUnit.loadState(archive) && envelopeUnit.loadState(archive)
+      && archive.read(averagedCycles) && archive.read(averagedHighCycles);
+}
+
+void FrameSequencer::clock(uint32_t numClocks, SoundController& controller)
+{
+   for (uint32_t i = 0; i < numClocks; ++i)
    {
-   case 0:
-      owner.lengthClock();
-      break;
-   case 1:
-      break;
-   case 2:
-      owner.lengthClock();
-      owner.sweepClock();
-      break;
-   case 3:
-      break;
-   case 4:
-      owner.lengthClock();
-      break;
-   case 5:
-      break;
-   case 6:
-      owner.lengthClock();
-      owner.sweepClock();
-      break;
-   case 7:
-      owner.envelopeClock();
-      break;
-   }
+      switch (step)
+      {
+      case 0:
+         controller.lengthClock();
+         break;
+      case 1:
+         break;
+      case 2:
+         controller.lengthClock();
+         controller.sweepClock();
+         break;
+      case 3:
+         break;
+      case 4:
+         controller.lengthClock();
+         break;
+      case 5:
+         break;
+      case 6:
+         controller.lengthClock();
+         controller.sweepClock();
+         break;
+      case 7:
+         controller.envelopeClock();
+         break;
+      }
 
-   step = (step + 1) % 8;
+      step = (step + 1) % 8;
+   }
 }
 
 AudioSample Mixer::mix(int8_t square1Sample, int8_t square2Sample, int8_t waveSample, int8_t noiseSample) const
@@ -447,27 +697,28 @@ AudioSample Mixer::mix(int8_t square1Sample, int8_t square2Sample, int8_t waveSa
       && waveSample >= -8 && waveSample <= 7
       && noiseSample >= -15 && noiseSample <= 15);
 
-   int8_t square1LeftSample = square1Sample * square1LeftEnabled;
-   int8_t square1RightSample = square1Sample * square1RightEnabled;
-
-   int8_t square2LeftSample = square2Sample * square2LeftEnabled;
-   int8_t square2RightSample = square2Sample * square2RightEnabled;
+   AudioSample sample;
+   sample.left = square1Sample * leftGains[0] + square2Sample * leftGains[1] + waveSample * leftGains[2] + noiseSample * leftGains[3];
+   sample.right = square1Sample * rightGains[0] + square2Sample * rightGains[1] + waveSample * rightGains[2] + noiseSample * rightGains[3];
 
-   int8_t waveLeftSample = waveSample * waveLeftEnabled;
-   int8_t waveRightSample = waveSample * waveRightEnabled;
+   return sample;
+}
 
-   int8_t noiseLeftSample = noiseSample * noiseLeftEnabled;
-   int8_t noiseRightSample = noiseSample * noiseRightEnabled;
+void Mixer::mix(const MixBlock& block, AudioSample* samples) const
+{
+   DM_ASSERT(block.numSamples <= MixBlock::kMaxSamples);
 
-   // Each of the 4 samples uses a max of 5 bits (-15 = 0b11110001, 15 = 0b00001111)
-   // Adding all 4 samples uses a max of 7 bits (value can double each time, meaning two shifts)
-   // Volume multiplication has a max value of 8 (causing a max shift of 3 bits) producing a total usage of 10 bits
-   // That gives us a total of 6 bits left over, which we can shift into to maximize volume
-   AudioSample sample;
-   sample.left = ((square1LeftSample + square2LeftSample + waveLeftSample + noiseLeftSample) * leftVolume) << 6;
-   sample.right = ((square1RightSample + square2RightSample + waveRightSample + noiseRightSample) * rightVolume) << 6;
+   // No branches and only 16 bit math, so the compiler can turn this into a few vector multiply-adds per block of samples
+   for (std::size_t i = 0; i < block.numSamples; ++i)
+   {
+      int16_t square1Sample = block.square1Samples[i];
+      int16_t square2Sample = block.square2Samples[i];
+      int16_t waveSample = block.waveSamples[i];
+      int16_t noiseSample = block.noiseSamples[i];
 
-   return sample;
+      samples[i].left = square1Sample * leftGains[0] + square2Sample * leftGains[1] + waveSample * leftGains[2] + noiseSample * leftGains[3];
+      samples[i].right = square1Sample * rightGains[0] + square2Sample * rightGains[1] + waveSample * rightGains[2] + noiseSample * rightGains[3];
+   }
 }
 
 uint8_t Mixer::readNr50() const
@@ -509,6 +760,8 @@ void Mixer::writeNr50(uint8_t value)
 
    vinLeftEnabled = (value & 0x80) != 0x00;
    vinRightEnabled = (value & 0x08) != 0x00;
+
+   updateGains();
 }
 
 void Mixer::writeNr51(uint8_t value)
@@ -521,68 +774,453 @@ void Mixer::writeNr51(uint8_t value)
    waveRightEnabled = (value & 0x04) != 0x00;
    noiseLeftEnabled = (value & 0x80) != 0x00;
    noiseRightEnabled = (value & 0x08) != 0x00;
+
+   updateGains();
 }
 
-SoundController::SoundController()
-   : frameSequencer(*this)
+void Mixer::saveState(Archive& archive) const
 {
-   // Try to guess a reasonable amount of data to reserve
-   // For now, 1/30th of a second's worth
-   static const std::size_t kReserveSamples = kSampleRate / 30;
+   archive.write(readNr50());
+   archive.write(readNr51());
+}
 
-   for (std::vector<AudioSample>& buffer : buffers)
+bool Mixer::loadState(ArchiveView& archive)
+{
+   uint8_t nr50 = 0x00;
+   uint8_t nr51 = 0x00;
+   if (!archive.read(nr50) || !archive.read(nr51))
    {
-      buffer.reserve(kReserveSamples);
+      return false;
    }
 
+   writeNr50(nr50);
+   writeNr51(nr51);
+
+   return true;
+}
+
+void Mixer::updateGains()
+{
+   // Each of the 4 samples uses a max of 5 bits (-15 = 0b11110001, 15 = 0b00001111)
+   // Adding all 4 samples uses a max of 7 bits (value can double each time, meaning two shifts)
+   // Volume multiplication has a max value of 8 (causing a max shift of 3 bits) producing a total usage of 10 bits
+   // That gives us a total of 6 bits left over, which we can shift into to maximize volume (so the mix can never
+   // overflow, and doesn't need to be saturated)
+   leftGains[0] = (square1LeftEnabled * leftVolume) << 6;
+   leftGains[1] = (square2LeftEnabled * leftVolume) << 6;
+   leftGains[2] = (waveLeftEnabled * leftVolume) << 6;
+   leftGains[3] = (noiseLeftEnabled * leftVolume) << 6;
+
+   rightGains[0] = (square1RightEnabled * rightVolume) << 6;
+   rightGains[1] = (square2RightEnabled * rightVolume) << 6;
+   rightGains[2] = (waveRightEnabled * rightVolume) << 6;
+   rightGains[3] = (noiseRightEnabled * rightVolume) << 6;
+}
+
+SoundController::SoundController()
+   : audioBufferDuration(kDefaultAudioBufferDuration)
+   , audioBuffer(samplesForDuration(kSampleRate, kDefaultAudioBufferDuration))
+   , leftResampler(kSampleRate, kSampleRate)
+   , rightResampler(kSampleRate, kSampleRate)
+   , leftBandLimitedBuffer(CPU::kClockSpeed, kSampleRate, kBandLimitedFrameCycles)
+   , rightBandLimitedBuffer(CPU::kClockSpeed, kSampleRate, kBandLimitedFrameCycles)
 #if DM_WITH_UI
-   for (std::vector<int8_t>& buffer : square1Buffers)
+   , square1Buffer(samplesForDuration(kSampleRate, kDefaultAudioBufferDuration))
+   , square2Buffer(samplesForDuration(kSampleRate, kDefaultAudioBufferDuration))
+   , waveBuffer(samplesForDuration(kSampleRate, kDefaultAudioBufferDuration))
+   , noiseBuffer(samplesForDuration(kSampleRate, kDefaultAudioBufferDuration))
+#endif // DM_WITH_UI
+{
+}
+
+SoundController::~SoundController()
+{
+}
+
+void SoundController::setGenerateAudioData(bool generateAudioData)
+{
+   catchUp();
+
+   generateData = generateAudioData;
+
+   if (!generateData)
    {
-      buffer.reserve(kReserveSamples);
+      cyclesSinceLastSample = 0;
+      audioReadIndex = audioBuffer.getWriteIndex();
+      mixBlock.numSamples = 0;
+
+      resetBandLimitedSynthesis();
+      leftResampler.clear();
+      rightResampler.clear();
    }
-   for (std::vector<int8_t>& buffer : square2Buffers)
+
+   scheduleNextEvent();
+}
+
+void SoundController::setOutputSuspended(bool suspended)
+{
+   if (suspended == outputSuspended)
    {
-      buffer.reserve(kReserveSamples);
+      return;
    }
-   for (std::vector<int8_t>& buffer : waveBuffers)
+
+   catchUp();
+
+   outputSuspended = suspended;
+
+   if (!outputSuspended)
    {
-      buffer.reserve(kReserveSamples);
+      // Whatever the mix is now gets picked up as a step on the next span
+      outputChanged = true;
    }
-   for (std::vector<int8_t>& buffer : noiseBuffers)
+
+   scheduleNextEvent();
+}
+
+#if DM_WITH_UI
+void SoundController::setGenerateChannelData(bool newGenerateChannelData)
+{
+   if (newGenerateChannelData == generateChannelData)
    {
-      buffer.reserve(kReserveSamples);
+      return;
    }
+
+   catchUp();
+
+   generateChannelData = newGenerateChannelData;
+
+   scheduleNextEvent();
+}
 #endif // DM_WITH_UI
+
+void SoundController::setOutputSampleRate(uint32_t newOutputSampleRate)
+{
+   DM_ASSERT(newOutputSampleRate > 0 && newOutputSampleRate < CPU::kClockSpeed);
+
+   if (newOutputSampleRate == outputSampleRate)
+   {
+      return;
+   }
+
+   catchUp();
+
+   outputSampleRate = newOutputSampleRate;
+
+   // The capture's sample rate is fixed for the whole file
+   stopAudioCapture();
+
+   // Samples that were already generated at the old rate would play back at the wrong speed (resizing drops them)
+   resizeAudioBuffer();
+
+   leftResampler = Resampler(kSampleRate, outputSampleRate);
+   rightResampler = Resampler(kSampleRate, outputSampleRate);
+
+   leftBandLimitedBuffer = BandLimitedBuffer(CPU::kClockSpeed, outputSampleRate, kBandLimitedFrameCycles);
+   rightBandLimitedBuffer = BandLimitedBuffer(CPU::kClockSpeed, outputSampleRate, kBandLimitedFrameCycles);
+   resetBandLimitedSynthesis();
+
+   scheduleNextEvent();
+}
+
+void SoundController::setAudioBufferDuration(double seconds)
+{
+   DM_ASSERT(seconds > 0.0);
+
+   catchUp();
+
+   audioBufferDuration = seconds;
+   resizeAudioBuffer();
 }
 
-void SoundController::machineCycle()
+void SoundController::setSynthesisMode(SynthesisMode newSynthesisMode)
 {
-   static const uint8_t kCyclesPerSample = CPU::kClockSpeed / kSampleRate;
-   DM_STATIC_ASSERT(CPU::kClockSpeed % kSampleRate == 0, "Sample rate does not divide evenly into the CPU clock speed!");
+   catchUp();
+   mixPendingSamples();
 
-   frameSequencer.machineCycle();
+   synthesisMode = newSynthesisMode;
+   resetBandLimitedSynthesis();
+   leftResampler.clear();
+   rightResampler.clear();
 
-   squareWaveChannel1.machineCycle();
-   squareWaveChannel2.machineCycle();
-   waveChannel.machineCycle();
-   noiseChannel.machineCycle();
+   scheduleNextEvent();
+}
+
+std::size_t SoundController::readAudioData(AudioSample* samples, std::size_t maxSamples)
+{
+   catchUp();
+   flushPendingOutput();
+
+   return audioBuffer.read(audioReadIndex, samples, maxSamples);
+}
+
+bool SoundController::startAudioCapture(const std::string& path, bool captureChannels, std::string& error)
+{
+   stopAudioCapture();
+
+   audioCapture = AudioCapture::create(path, outputSampleRate, captureChannels, error);
+   if (!audioCapture)
+   {
+      return false;
+   }
+
+   // Only samples generated from here on are captured
+   captureReadIndex = audioBuffer.getWriteIndex();
+   captureChannelData = captureChannels;
+   scheduleNextEvent();
+
+   return true;
+}
+
+void SoundController::stopAudioCapture()
+{
+   if (!audioCapture)
+   {
+      return;
+   }
+
+   catchUp();
+   flushPendingOutput();
+
+   audioCapture = nullptr;
+   captureChannelData = false;
+   scheduleNextEvent();
+}
+
+uint64_t SoundController::getNumDroppedCaptureSamples() const
+{
+   return audioCapture ? audioCapture->getNumDroppedSamples() : 0;
+}
+
+void SoundController::catchUp()
+{
+   while (pendingMachineCycles > 0)
+   {
+      uint32_t numMachineCycles = std::min(pendingMachineCycles, machineCyclesUntilEvent);
+
+      advance(numMachineCycles);
+      pendingMachineCycles -= numMachineCycles;
+
+      scheduleNextEvent();
+   }
+}
+
+void SoundController::reset()
+{
+   loadSnapshot(SoundControllerState());
+}
+
+void SoundController::saveState(Archive& archive)
+{
+   catchUp();
+
+   frameSequencer.saveState(archive);
+   mixer.saveState(archive);
+   archive.write(powerEnabled);
+
+   squareWaveChannel1.saveState(archive);
+   squareWaveChannel2.saveState(archive);
+   waveChannel.saveState(archive);
+   noiseChannel.saveState(archive);
+
+   archive.write(cyclesSinceLastSample);
+}
+
+bool SoundController::loadState(ArchiveView& archive)
+{
+   // Cycles from before the load still belong to the old state
+   catchUp();
+
+   // Samples that haven't been mixed yet were taken with the old volume and panning
+   mixPendingSamples();
+
+   bool loaded = frameSequencer.loadState(archive) && mixer.loadState(archive) && archive.read(powerEnabled)
+      && squareWaveChannel1.loadState(archive) && squareWaveChannel2.loadState(archive)
+      && waveChannel.loadState(archive) && noiseChannel.loadState(archive)
+      && archive.read(cyclesSinceLastSample);
+
+   // The output jumps straight to the loaded state (the band-limited output picks up the step on the next span)
+   outputChanged = true;
+   scheduleNextEvent();
+
+   return loaded;
+}
+
+void SoundController::hashState(Hasher& hasher)
+{
+   // Reuses the archive's memory from last time
+   hashArchive.clear();
+   saveState(hashArchive);
 
-   cyclesSinceLastSample += CPU::kClockCyclesPerMachineCycle;
+   hasher.writeBytes(hashArchive.getBytes(), hashArchive.getSize());
+}
+
+void SoundController::saveSnapshot(SoundControllerState& state)
+{
+   catchUp();
+
+   state = *this;
+}
+
+void SoundController::loadSnapshot(const SoundControllerState& state)
+{
+   catchUp();
+   mixPendingSamples();
+
+   static_cast<SoundControllerState&>(*this) = state;
+
+   outputChanged = true;
+   scheduleNextEvent();
+}
+
+void SoundController::copyStateFrom(SoundController& other)
+{
+   DM_ASSERT(&other != this);
+
+   other.catchUp();
 
-   if (cyclesSinceLastSample >= kCyclesPerSample)
+   loadSnapshot(other);
+}
+
+void SoundController::advance(uint32_t numMachineCycles)
+{
+   DM_ASSERT(numMachineCycles > 0 && numMachineCycles <= machineCyclesUntilEvent);
+
+   uint32_t cycles = numMachineCycles * CPU::kClockCyclesPerMachineCycle;
+
+   // Nothing is clocked while powered off (only the output keeps being sampled)
+   if (powerEnabled)
    {
-      cyclesSinceLastSample -= kCyclesPerSample;
-      DM_ASSERT(cyclesSinceLastSample < kCyclesPerSample);
+      if (cycles >= frameSequencer.cyclesUntilClock())
+      {
+         // The frame sequencer is only ever due in the last machine cycle of a span, and is clocked before the channels
+         // step through that machine cycle (a sweep can change the period the square wave timer reloads with)
+         uint32_t leadingCycles = cycles - CPU::kClockCyclesPerMachineCycle;
+         DM_ASSERT(leadingCycles < frameSequencer.cyclesUntilClock() || frameSequencer.cyclesUntilClock() == 0);
 
-      if (generateData)
+         if (leadingCycles > 0)
+         {
+            advanceChannels(leadingCycles);
+         }
+         frameSequencer.advance(cycles, *this);
+         advanceChannels(CPU::kClockCyclesPerMachineCycle);
+      }
+      else
       {
+         frameSequencer.advance(cycles, *this);
+         advanceChannels(cycles);
+      }
+   }
+
+   uint32_t sampleCycles = cyclesSinceLastSample + cycles;
+   cyclesSinceLastSample = sampleCycles % kCyclesPerSample;
+
+   if (isGeneratingOutput())
+   {
+      if (synthesisMode == SynthesisMode::BandLimited)
+      {
+         // Spans end on every machine cycle that clocks a channel or follows a register write, so the output can only
+         // have changed at the end of this one
+         bandLimitedFrameCycles += cycles;
+         addBandLimitedDeltas();
+         outputChanged = false;
+
+         if (bandLimitedFrameCycles >= kBandLimitedFrameCycles)
+         {
+            flushBandLimitedSamples();
+         }
+      }
+
+      if (sampleCycles >= kCyclesPerSample && samplesNeeded())
+      {
+         DM_ASSERT(sampleCycles < kCyclesPerSample * 2);
          pushSample();
       }
    }
+
+   if (sampleCycles >= kCyclesPerSample)
+   {
+      // The noise channel's output is averaged over each sample period
+      noiseChannel.restartAveraging();
+   }
+}
+
+void SoundController::advanceChannels(uint32_t cycles)
+{
+   // Disabled channels output silence no matter where their timers are, so their timers are left alone until they are
+   // triggered again (which reloads them)
+   if (squareWaveChannel1.isEnabled())
+   {
+      squareWaveChannel1.advance(cycles);
+   }
+   if (squareWaveChannel2.isEnabled())
+   {
+      squareWaveChannel2.advance(cycles);
+   }
+   if (waveChannel.isEnabled())
+   {
+      waveChannel.advance(cycles);
+   }
+   if (noiseChannel.isEnabled())
+   {
+      noiseChannel.advance(cycles);
+   }
+}
+
+uint32_t SoundController::cyclesUntilChannelClock() const
+{
+   uint32_t cycles = std::numeric_limits<uint32_t>::max();
+
+   if (squareWaveChannel1.isEnabled())
+   {
+      cycles = std::min(cycles, squareWaveChannel1.cyclesUntilClock());
+   }
+   if (squareWaveChannel2.isEnabled())
+   {
+      cycles = std::min(cycles, squareWaveChannel2.cyclesUntilClock());
+   }
+   if (waveChannel.isEnabled())
+   {
+      cycles = std::min(cycles, waveChannel.cyclesUntilClock());
+   }
+   if (noiseChannel.isEnabled())
+   {
+      cycles = std::min(cycles, noiseChannel.cyclesUntilClock());
+   }
+
+   return cycles;
+}
+
+void SoundController::scheduleNextEvent()
+{
+   // While powered off, nothing is due until the output has to be sampled (or a register is written)
+   uint32_t cycles = powerEnabled ? frameSequencer.cyclesUntilClock() : kMaxSpanCycles;
+
+   if (isGeneratingOutput())
+   {
+      if (samplesNeeded())
+      {
+         cycles = std::min(cycles, kCyclesPerSample - cyclesSinceLastSample);
+      }
+
+      if (synthesisMode == SynthesisMode::BandLimited)
+      {
+         cycles = std::min({ cycles, kBandLimitedFrameCycles - bandLimitedFrameCycles, cyclesUntilChannelClock() });
+
+         if (outputChanged)
+         {
+            cycles = 0;
+         }
+      }
+   }
+
+   // Events are handled at the end of the machine cycle they fall in
+   machineCyclesUntilEvent = std::max<uint32_t>(1, (cycles + CPU::kClockCyclesPerMachineCycle - 1) / CPU::kClockCyclesPerMachineCycle);
 }
 
 uint8_t SoundController::read(uint16_t address) const
 {
+   // No catching up is needed here: everything visible through the registers (channel status, length and sweep state)
+   // only changes on frame sequencer clocks, which are always stepped to as they happen
    uint8_t value = GameBoy::kInvalidAddressByte;
 
    if (address >= 0xFF10 && address <= 0xFF14)
@@ -629,12 +1267,16 @@ uint8_t SoundController::read(uint16_t address) const
 
 void SoundController::write(uint16_t address, uint8_t value)
 {
+   catchUp();
+
    if (!powerEnabled && address != 0xFF26)
    {
       // TODO Except length counters?
       return;
    }
 
+   outputChanged = true;
+
    if (address >= 0xFF10 && address <= 0xFF14)
    {
       // Channel 1
@@ -658,12 +1300,15 @@ void SoundController::write(uint16_t address, uint8_t value)
    else
    {
       // Control / Status
+      // Samples that have already been taken are mixed with the old volume and panning
       switch (address)
       {
       case 0xFF24:
+         mixPendingSamples();
          mixer.writeNr50(value);
          break;
       case 0xFF25:
+         mixPendingSamples();
          mixer.writeNr51(value);
          break;
       case 0xFF26:
@@ -673,6 +1318,8 @@ void SoundController::write(uint16_t address, uint8_t value)
          break;
       }
    }
+
+   scheduleNextEvent();
 }
 
 uint8_t SoundController::readNr52() const
@@ -719,17 +1366,140 @@ void SoundController::pushSample()
    int8_t square1Sample = squareWaveChannel1.getCurrentAudioSample();
    int8_t square2Sample = squareWaveChannel2.getCurrentAudioSample();
    int8_t waveSample = waveChannel.getCurrentAudioSample();
-   int8_t noiseSample = noiseChannel.getCurrentAudioSample();
+   int8_t noiseSample = noiseChannel.getAveragedAudioSample();
 
-   AudioSample sample = mixer.mix(square1Sample, square2Sample, waveSample, noiseSample);
-   buffers[activeBufferIndex].push_back(sample);
+   if (synthesisMode == SynthesisMode::PointSampled)
+   {
+      std::size_t index = mixBlock.numSamples++;
+      mixBlock.square1Samples[index] = square1Sample;
+      mixBlock.square2Samples[index] = square2Sample;
+      mixBlock.waveSamples[index] = waveSample;
+      mixBlock.noiseSamples[index] = noiseSample;
+
+      if (mixBlock.numSamples == MixBlock::kMaxSamples)
+      {
+         mixPendingSamples();
+      }
+   }
 
 #if DM_WITH_UI
-   square1Buffers[activeBufferIndex].push_back(square1Sample);
-   square2Buffers[activeBufferIndex].push_back(square2Sample);
-   waveBuffers[activeBufferIndex].push_back(waveSample);
-   noiseBuffers[activeBufferIndex].push_back(noiseSample);
+   if (generateChannelData)
+   {
+      square1Buffer.push(square1Sample);
+      square2Buffer.push(square2Sample);
+      waveBuffer.push(waveSample);
+      noiseBuffer.push(noiseSample);
+   }
 #endif // DM_WITH_UI
+
+   if (captureChannelData)
+   {
+      audioCapture->writeChannels({ square1Sample, square2Sample, waveSample, noiseSample });
+   }
+}
+
+void SoundController::addBandLimitedDeltas()
+{
+   AudioSample sample = mixer.mix(squareWaveChannel1.getCurrentAudioSample(), squareWaveChannel2.getCurrentAudioSample(), waveChannel.getCurrentAudioSample(), noiseChannel.getCurrentAudioSample());
+
+   if (sample.left != lastBandLimitedSample.left)
+   {
+      leftBandLimitedBuffer.addDelta(bandLimitedFrameCycles, sample.left - lastBandLimitedSample.left);
+   }
+   if (sample.right != lastBandLimitedSample.right)
+   {
+      rightBandLimitedBuffer.addDelta(bandLimitedFrameCycles, sample.right - lastBandLimitedSample.right);
+   }
+
+   lastBandLimitedSample = sample;
+}
+
+void SoundController::flushBandLimitedSamples()
+{
+   leftBandLimitedBuffer.endFrame(bandLimitedFrameCycles);
+   rightBandLimitedBuffer.endFrame(bandLimitedFrameCycles);
+   bandLimitedFrameCycles = 0;
+
+   transferSamples(leftBandLimitedBuffer, rightBandLimitedBuffer, audioBuffer);
+   captureOutput();
+}
+
+void SoundController::flushPendingOutput()
+{
+   if (synthesisMode == SynthesisMode::BandLimited)
+   {
+      flushBandLimitedSamples();
+      scheduleNextEvent();
+   }
+   else
+   {
+      mixPendingSamples();
+   }
+}
+
+void SoundController::mixPendingSamples()
+{
+   if (mixBlock.numSamples == 0)
+   {
+      return;
+   }
+
+   std::array<AudioSample, MixBlock::kMaxSamples> samples;
+   mixer.mix(mixBlock, samples.data());
+
+   if (isResampling())
+   {
+      for (std::size_t i = 0; i < mixBlock.numSamples; ++i)
+      {
+         leftResampler.write(samples[i].left);
+         rightResampler.write(samples[i].right);
+      }
+
+      flushResampledSamples();
+   }
+   else
+   {
+      audioBuffer.write(samples.data(), mixBlock.numSamples);
+   }
+
+   mixBlock.numSamples = 0;
+   captureOutput();
+}
+
+void SoundController::flushResampledSamples()
+{
+   transferSamples(leftResampler, rightResampler, audioBuffer);
+}
+
+void SoundController::captureOutput()
+{
+   if (!audioCapture)
+   {
+      return;
+   }
+
+   // Everything written to the output buffer is captured right away, so it is never overwritten before it is read
+   std::array<AudioSample, MixBlock::kMaxSamples> samples;
+   while (std::size_t numSamples = audioBuffer.read(captureReadIndex, samples.data(), samples.size()))
+   {
+      audioCapture->writeMix(samples.data(), numSamples);
+   }
+}
+
+void SoundController::resizeAudioBuffer()
+{
+   audioBuffer = RingBuffer<AudioSample>(samplesForDuration(outputSampleRate, audioBufferDuration));
+   audioReadIndex = 0;
+   captureReadIndex = 0;
+}
+
+void SoundController::resetBandLimitedSynthesis()
+{
+   leftBandLimitedBuffer.clear();
+   rightBandLimitedBuffer.clear();
+   lastBandLimitedSample = {};
+   bandLimitedFrameCycles = 0;
+   outputChanged = true;
 }
 
 } // namespace DotMatrix
@@ -1,14 +1,26 @@
 #pragma once
 
+#include "Core/Archive.h"
+#include "Core/Hash.h"
+#include "Core/RingBuffer.h"
+
+#include "GameBoy/BandLimitedBuffer.h"
 #include "GameBoy/CPU.h"
+#include "GameBoy/Resampler.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 namespace DotMatrix
 {
 
+class AudioCapture;
 class SoundController;
 class SquareWaveChannel;
 
@@ -32,6 +44,16 @@ public:
    }
 
 protected:
+   void saveState(Archive& archive) const
+   {
+      archive.write(enabled);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(enabled);
+   }
+
    void trigger()
    {
       enabled = true;
@@ -41,30 +63,42 @@ private:
    bool enabled = true;
 };
 
-template<typename Owner>
 class SoundTimer
 {
 public:
-   SoundTimer(Owner& owningObject)
-      : owner(owningObject)
+   // Clock cycles the timer has to advance by for the owner to be clocked (the max value if the timer is stopped)
+   uint32_t cyclesUntilClock() const
    {
+      return period == 0 ? std::numeric_limits<uint32_t>::max() : counter;
    }
 
-   void machineCycle()
+   // Advances the timer over a whole span of clock cycles, returning the number of times it expired (which the owner is
+   // then clocked with, once)
+   uint32_t advance(uint32_t cycles)
    {
-      uint32_t cycles = CPU::kClockCyclesPerMachineCycle;
+      DM_ASSERT(cycles > 0);
 
-      if (period != 0)
+      if (period == 0)
       {
-         while (cycles >= counter)
-         {
-            cycles -= counter;
-            owner.clock();
-            counter = period;
-         }
+         return 0;
+      }
 
+      if (cycles < counter)
+      {
          counter -= cycles;
+         return 0;
       }
+
+      uint32_t remainingCycles = cycles - counter;
+      uint32_t numClocks = 1 + remainingCycles / period;
+      counter = period - remainingCycles % period;
+
+      return numClocks;
+   }
+
+   uint32_t getPeriod() const
+   {
+      return period;
    }
 
    void setPeriod(uint32_t newPeriod)
@@ -72,8 +106,23 @@ public:
       period = newPeriod;
    }
 
+   void reload()
+   {
+      counter = period;
+   }
+
+   void saveState(Archive& archive) const
+   {
+      archive.write(period);
+      archive.write(counter);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(period) && archive.read(counter);
+   }
+
 private:
-   Owner& owner;
    uint32_t period = 0;
    uint32_t counter = 0;
 };
@@ -81,10 +130,13 @@ private:
 class DutyUnit
 {
 public:
-   void clock()
+   void clock(uint32_t numClocks)
    {
-      high = kDutyMasks[index][counter];
-      counter = (counter + 1) % 8;
+      DM_ASSERT(numClocks > 0);
+
+      // Only the last step matters
+      high = kDutyMasks[index][(counter + numClocks - 1) % 8];
+      counter = (counter + numClocks) % 8;
    }
 
    void reset()
@@ -108,6 +160,18 @@ public:
       return high;
    }
 
+   void saveState(Archive& archive) const
+   {
+      archive.write(counter);
+      archive.write(index);
+      archive.write(high);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(counter) && archive.read(index) && archive.read(high);
+   }
+
 private:
    static constexpr const std::array<std::array<bool, 8>, 4> kDutyMasks =
    {{
@@ -125,14 +189,13 @@ private:
 class LengthUnit
 {
 public:
-   LengthUnit(SoundChannel& owningSoundChannel, uint16_t maxCounterValue)
-      : owner(owningSoundChannel)
-      , maxCounter(maxCounterValue)
+   LengthUnit(uint16_t maxCounterValue)
+      : maxCounter(maxCounterValue)
    {
       DM_ASSERT(maxCounter == 64 || maxCounter == 256);
    }
 
-   void clock()
+   void clock(SoundChannel& channel)
    {
       if (enabled && counter > 0)
       {
@@ -140,7 +203,7 @@ public:
 
          if (counter == 0)
          {
-            owner.disable();
+            channel.disable();
          }
       }
    }
@@ -176,9 +239,20 @@ public:
       enabled = (value & 0x40) != 0x00;
    }
 
+   void saveState(Archive& archive) const
+   {
+      archive.write(counter);
+      archive.write(counterLoad);
+      archive.write(enabled);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(counter) && archive.read(counterLoad) && archive.read(enabled);
+   }
+
 private:
-   SoundChannel& owner;
-   const uint16_t maxCounter;
+   uint16_t maxCounter = 0;
    uint16_t counter = 0;
    uint8_t counterLoad = 0;
    bool enabled = false;
@@ -229,6 +303,23 @@ public:
       return volume;
    }
 
+   void saveState(Archive& archive) const
+   {
+      archive.write(period);
+      archive.write(counter);
+      archive.write(volume);
+      archive.write(volumeLoad);
+      archive.write(addMode);
+      archive.write(enabled);
+      archive.write(dacPowered);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(period) && archive.read(counter) && archive.read(volume) && archive.read(volumeLoad)
+         && archive.read(addMode) && archive.read(enabled) && archive.read(dacPowered);
+   }
+
 private:
    void resetCounter()
    {
@@ -248,14 +339,9 @@ private:
 class SweepUnit
 {
 public:
-   SweepUnit(SquareWaveChannel& owningSquareWaveChannel)
-      : owner(owningSquareWaveChannel)
-   {
-   }
+   void clock(SquareWaveChannel& channel);
 
-   void clock();
-
-   void trigger()
+   void trigger(SquareWaveChannel& channel)
    {
       // Sweep timer is reloaded
       resetCounter();
@@ -265,7 +351,7 @@ public:
       if (shift != 0)
       {
          // Frequency calculation and the overflow check are performed immediately
-         calculateNewFrequency();
+         calculateNewFrequency(channel);
       }
    }
 
@@ -302,7 +388,23 @@ public:
       enabled = period != 0 || shift != 0;
    }
 
-   uint16_t calculateNewFrequency();
+   uint16_t calculateNewFrequency(SquareWaveChannel& channel);
+
+   void saveState(Archive& archive) const
+   {
+      archive.write(shadowFrequency);
+      archive.write(period);
+      archive.write(counter);
+      archive.write(shift);
+      archive.write(negate);
+      archive.write(enabled);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(shadowFrequency) && archive.read(period) && archive.read(counter) && archive.read(shift)
+         && archive.read(negate) && archive.read(enabled);
+   }
 
 private:
    void resetCounter()
@@ -311,8 +413,6 @@ private:
       counter = period == 0 ? 8 : period;
    }
 
-   SquareWaveChannel& owner;
-
    uint16_t shadowFrequency = 0;
    uint8_t period = 0;
    uint8_t counter = 8;
@@ -324,9 +424,9 @@ private:
 class WaveUnit
 {
 public:
-   void clock()
+   void clock(uint32_t numClocks)
    {
-      position = (position + 1) % 32;
+      position = (position + numClocks) % 32;
    }
 
    void trigger()
@@ -377,6 +477,19 @@ public:
       waveTable[index] = value;
    }
 
+   void saveState(Archive& archive) const
+   {
+      archive.write(position);
+      archive.write(volumeCode);
+      archive.write(dacPowered);
+      archive.write(waveTable);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(position) && archive.read(volumeCode) && archive.read(dacPowered) && archive.read(waveTable);
+   }
+
 private:
    uint8_t position = 0;
    uint8_t volumeCode = 0;
@@ -387,11 +500,13 @@ private:
 class LFSRUnit
 {
 public:
-   void clock();
+   // Steps the register numClocks times, and returns how many of the states it stepped through were high
+   uint32_t clock(uint32_t numClocks);
 
    void trigger()
    {
       lfsr = 0xFFFF;
+      stepsUntilSettled = kSettleSteps;
    }
 
    uint8_t readNrx3() const
@@ -411,8 +526,14 @@ public:
 
    void writeNrx3(uint8_t value)
    {
+      bool newWidthMode = (value & 0x08) != 0x00;
+      if (newWidthMode != widthMode)
+      {
+         stepsUntilSettled = kSettleSteps;
+      }
+
       clockShift = (value & 0xF0) >> 4;
-      widthMode = (value & 0x08) != 0x00;
+      widthMode = newWidthMode;
       divisorCode = value & 0x07;
    }
 
@@ -431,11 +552,31 @@ public:
       return kDivisorValues[divisorCode] << clockShift;
    }
 
+   // Steps after a trigger or a width mode change before the register only holds states from its mode's cycle (the bits
+   // above the 7-bit register are refilled with copies of its feedback, and the top bit set on a trigger is shifted out)
+   static const uint8_t kSettleSteps = 8;
+
+   void saveState(Archive& archive) const
+   {
+      archive.write(clockShift);
+      archive.write(widthMode);
+      archive.write(divisorCode);
+      archive.write(lfsr);
+      archive.write(stepsUntilSettled);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return archive.read(clockShift) && archive.read(widthMode) && archive.read(divisorCode) && archive.read(lfsr)
+         && archive.read(stepsUntilSettled);
+   }
+
 private:
    uint8_t clockShift = 0;
    bool widthMode = false;
    uint8_t divisorCode = 0;
    uint16_t lfsr = 0xFFFF;
+   uint8_t stepsUntilSettled = kSettleSteps;
 };
 
 class SquareWaveChannel : public SoundChannel
@@ -453,19 +594,28 @@ public:
    uint8_t read(uint16_t address) const;
    void write(uint16_t address, uint8_t value);
 
-   void machineCycle()
+   uint32_t cyclesUntilClock() const
+   {
+      return timer.cyclesUntilClock();
+   }
+
+   void advance(uint32_t cycles)
    {
-      timer.machineCycle();
+      uint32_t numClocks = timer.advance(cycles);
+      if (numClocks > 0)
+      {
+         clock(numClocks);
+      }
    }
 
-   void clock()
+   void clock(uint32_t numClocks)
    {
-      dutyUnit.clock();
+      dutyUnit.clock(numClocks);
    }
 
    void lengthClock()
    {
-      lengthUnit.clock();
+      lengthUnit.clock(*this);
    }
 
    void envelopeClock()
@@ -475,16 +625,22 @@ public:
 
    void sweepClock()
    {
-      sweepUnit.clock();
+      sweepUnit.clock(*this);
    }
 
    void trigger()
    {
       SoundChannel::trigger();
 
+      timer.reload();
       lengthUnit.trigger();
       envelopeUnit.trigger();
-      sweepUnit.trigger();
+      sweepUnit.trigger(*this);
+
+      if (!envelopeUnit.isDacPowered())
+      {
+         disable();
+      }
    }
 
    void resetDutyUnit()
@@ -498,8 +654,11 @@ public:
       timer.setPeriod((2048 - frequency) * 4);
    }
 
+   void saveState(Archive& archive) const;
+   bool loadState(ArchiveView& archive);
+
 private:
-   SoundTimer<SquareWaveChannel> timer;
+   SoundTimer timer;
    uint16_t frequency = 0;
 
    DutyUnit dutyUnit;
@@ -523,27 +682,42 @@ public:
    uint8_t read(uint16_t address) const;
    void write(uint16_t address, uint8_t value);
 
-   void machineCycle()
+   uint32_t cyclesUntilClock() const
    {
-      timer.machineCycle();
+      return timer.cyclesUntilClock();
    }
 
-   void clock()
+   void advance(uint32_t cycles)
    {
-      waveUnit.clock();
+      uint32_t numClocks = timer.advance(cycles);
+      if (numClocks > 0)
+      {
+         clock(numClocks);
+      }
+   }
+
+   void clock(uint32_t numClocks)
+   {
+      waveUnit.clock(numClocks);
    }
 
    void lengthClock()
    {
-      lengthUnit.clock();
+      lengthUnit.clock(*this);
    }
 
    void trigger()
    {
       SoundChannel::trigger();
 
+      timer.reload();
       waveUnit.trigger();
       lengthUnit.trigger();
+
+      if (!waveUnit.isDacPowered())
+      {
+         disable();
+      }
    }
 
    void resetWaveUnit()
@@ -551,6 +725,9 @@ public:
       waveUnit.reset();
    }
 
+   void saveState(Archive& archive) const;
+   bool loadState(ArchiveView& archive);
+
 private:
    void setFrequency(uint16_t newFrequency)
    {
@@ -558,7 +735,7 @@ private:
       timer.setPeriod((2048 - frequency) * 2);
    }
 
-   SoundTimer<WaveChannel> timer;
+   SoundTimer timer;
    uint16_t frequency = 0;
 
    WaveUnit waveUnit;
@@ -577,22 +754,43 @@ public:
 
    int8_t getCurrentAudioSample() const;
 
+   // Output averaged over the cycles stepped through since the averaging was last restarted (when point sampling, this
+   // keeps high frequency noise from aliasing)
+   int8_t getAveragedAudioSample() const;
+
+   void restartAveraging()
+   {
+      averagedCycles = 0;
+      averagedHighCycles = 0;
+   }
+
    uint8_t read(uint16_t address) const;
    void write(uint16_t address, uint8_t value);
 
-   void machineCycle()
+   uint32_t cyclesUntilClock() const
    {
-      timer.machineCycle();
+      return timer.cyclesUntilClock();
    }
 
-   void clock()
+   void advance(uint32_t cycles)
    {
-      lfsrUnit.clock();
+      // Time spent in the current state (the rest of the span is accounted for when clocked)
+      uint32_t cyclesBeforeClock = std::min(cycles, timer.cyclesUntilClock());
+      averagedHighCycles += lfsrUnit.isHigh() ? cyclesBeforeClock : 0;
+      averagedCycles += cycles;
+
+      uint32_t numClocks = timer.advance(cycles);
+      if (numClocks > 0)
+      {
+         clock(numClocks);
+      }
    }
 
+   void clock(uint32_t numClocks);
+
    void lengthClock()
    {
-      lengthUnit.clock();
+      lengthUnit.clock(*this);
    }
 
    void envelopeClock()
@@ -604,59 +802,108 @@ public:
    {
       SoundChannel::trigger();
 
+      timer.reload();
       lfsrUnit.trigger();
       lengthUnit.trigger();
       envelopeUnit.trigger();
+
+      if (!envelopeUnit.isDacPowered())
+      {
+         disable();
+      }
    }
 
+   void saveState(Archive& archive) const;
+   bool loadState(ArchiveView& archive);
+
 private:
-   SoundTimer<NoiseChannel> timer;
+   SoundTimer timer;
 
    LFSRUnit lfsrUnit;
    LengthUnit lengthUnit;
    EnvelopeUnit envelopeUnit;
+
+   uint32_t averagedCycles = 0;
+   uint32_t averagedHighCycles = 0;
 };
 
 class FrameSequencer
 {
 public:
-   FrameSequencer(SoundController& owningSoundController)
-      : timer(*this)
-      , owner(owningSoundController)
+   FrameSequencer()
    {
       timer.setPeriod(CPU::kClockSpeed / 512);
    }
 
-   void machineCycle()
+   uint32_t cyclesUntilClock() const
    {
-      timer.machineCycle();
+      return timer.cyclesUntilClock();
    }
 
-   void clock();
+   void advance(uint32_t cycles, SoundController& controller)
+   {
+      uint32_t numClocks = timer.advance(cycles);
+      if (numClocks > 0)
+      {
+         clock(numClocks, controller);
+      }
+   }
+
+   void clock(uint32_t numClocks, SoundController& controller);
 
    void reset()
    {
       step = 0;
    }
 
+   void saveState(Archive& archive) const
+   {
+      timer.saveState(archive);
+      archive.write(step);
+   }
+
+   bool loadState(ArchiveView& archive)
+   {
+      return timer.loadState(archive) && archive.read(step);
+   }
+
 private:
-   SoundTimer<FrameSequencer> timer;
-   SoundController& owner;
+   SoundTimer timer;
    uint8_t step = 0;
 };
 
+// Channel samples waiting to be mixed together
+struct MixBlock
+{
+   static const std::size_t kMaxSamples = 64;
+
+   std::array<int8_t, kMaxSamples> square1Samples = {};
+   std::array<int8_t, kMaxSamples> square2Samples = {};
+   std::array<int8_t, kMaxSamples> waveSamples = {};
+   std::array<int8_t, kMaxSamples> noiseSamples = {};
+   std::size_t numSamples = 0;
+};
+
 class Mixer
 {
 public:
    AudioSample mix(int8_t square1Sample, int8_t square2Sample, int8_t waveSample, int8_t noiseSample) const;
 
+   // Mixes every sample in the block into the output
+   void mix(const MixBlock& block, AudioSample* samples) const;
+
    uint8_t readNr50() const;
    uint8_t readNr51() const;
 
    void writeNr50(uint8_t value);
    void writeNr51(uint8_t value);
 
+   void saveState(Archive& archive) const;
+   bool loadState(ArchiveView& archive);
+
 private:
+   void updateGains();
+
    uint8_t leftVolume = 0x01;
    uint8_t rightVolume = 0x01;
 
@@ -671,45 +918,133 @@ private:
    bool waveRightEnabled = false;
    bool noiseLeftEnabled = false;
    bool noiseRightEnabled = false;
+
+   // What each channel's samples are multiplied by (panning and master volume combined), in the order square 1,
+   // square 2, wave, noise
+   std::array<int16_t, 4> leftGains = {};
+   std::array<int16_t, 4> rightGains = {};
+};
+
+enum class SynthesisMode : uint8_t
+{
+   // The mix is sampled directly every kCyclesPerSample clocks (and resampled if the output sample rate differs)
+   PointSampled,
+
+   // Changes in the mix are turned into band-limited steps as they happen, and samples are generated from them in bulk
+   BandLimited
+};
+
+// Everything the APU needs to carry on from where it left off, kept in one trivially copyable block so that it can be
+// snapshotted and restored with a plain copy (the output pipeline and the host's settings live in SoundController)
+struct SoundControllerState
+{
+   FrameSequencer frameSequencer;
+   Mixer mixer;
+   bool powerEnabled = false;
+
+   SquareWaveChannel squareWaveChannel1;
+   SquareWaveChannel squareWaveChannel2;
+   WaveChannel waveChannel;
+   NoiseChannel noiseChannel;
+
+   uint8_t cyclesSinceLastSample = 0;
 };
 
-class SoundController
+DM_STATIC_ASSERT(std::is_trivially_copyable_v<SoundControllerState>, "Sound controller state can't be copied as plain memory!");
+
+class SoundController : private SoundControllerState
 {
 public:
+   // Native rate that the mix is sampled at, which divides evenly into the CPU clock speed
    static const size_t kSampleRate = 65536;
 
    SoundController();
+   ~SoundController();
 
-   void setGenerateAudioData(bool generateAudioData)
+   uint32_t getOutputSampleRate() const
    {
-      generateData = generateAudioData;
-
-      if (!generateData)
-      {
-         cyclesSinceLastSample = 0;
-         for (std::vector<AudioSample>& buffer : buffers)
-         {
-            buffer.clear();
-         }
-      }
+      return outputSampleRate;
    }
 
-   const std::vector<AudioSample>& swapAudioBuffers()
+   // Rate of the samples returned from readAudioData() (e.g. to match an audio device)
+   void setOutputSampleRate(uint32_t newOutputSampleRate);
+
+   // Number of samples that can be generated without being read before the oldest ones are overwritten
+   std::size_t getAudioBufferCapacity() const
    {
-      activeBufferIndex = !activeBufferIndex;
+      return audioBuffer.capacity();
+   }
+
+   // Sizes the output buffer to hold (at least) the given duration of audio at the output sample rate
+   void setAudioBufferDuration(double seconds);
+
+   void setGenerateAudioData(bool generateAudioData);
+
+   // While suspended, no audio is generated, but unlike turning generation off, the output is left exactly as it was
+   // (for frames nobody will hear, like run-ahead's hidden ones, after which a snapshot is restored and generation
+   // carries on seamlessly)
+   void setOutputSuspended(bool suspended);
 
-      buffers[activeBufferIndex].clear();
 #if DM_WITH_UI
-      square1Buffers[activeBufferIndex].clear();
-      square2Buffers[activeBufferIndex].clear();
-      waveBuffers[activeBufferIndex].clear();
-      noiseBuffers[activeBufferIndex].clear();
+   // Also record the output of each channel (at the native sample rate) for visualization
+   void setGenerateChannelData(bool newGenerateChannelData);
 #endif // DM_WITH_UI
 
-      return buffers[!activeBufferIndex];
+   SynthesisMode getSynthesisMode() const
+   {
+      return synthesisMode;
+   }
+
+   void setSynthesisMode(SynthesisMode newSynthesisMode);
+
+   // Copies up to maxSamples of the audio generated since the last read, and returns the number copied
+   std::size_t readAudioData(AudioSample* samples, std::size_t maxSamples);
+
+   // Streams the output (and optionally each channel, at the native sample rate) to WAV files until stopped, without
+   // waiting on the disk. Only audio that is generated is captured (see setGenerateAudioData()), and changing the output
+   // sample rate stops the capture.
+   bool startAudioCapture(const std::string& path, bool captureChannels, std::string& error);
+   void stopAudioCapture();
+
+   bool isCapturingAudio() const
+   {
+      return audioCapture != nullptr;
+   }
+
+   // Captured samples that were dropped because the disk couldn't keep up
+   uint64_t getNumDroppedCaptureSamples() const;
+
+   void machineCycle()
+   {
+      // The channels are only stepped when something observable is due (a frame sequencer clock, an output sample, an
+      // edge in band-limited mode) or a register is accessed, so most machine cycles are just counted
+      ++pendingMachineCycles;
+
+      if (pendingMachineCycles >= machineCyclesUntilEvent)
+      {
+         catchUp();
+      }
    }
 
-   void machineCycle();
+   // Steps everything through the machine cycles that have been counted but not yet applied
+   void catchUp();
+
+   // Back to the power-on state (host settings like the output sample rate are kept, as is audio waiting to be read)
+   void reset();
+
+   // Emulation state only (settings like the output sample rate belong to the host, and generated audio stays put)
+   void saveState(Archive& archive);
+   bool loadState(ArchiveView& archive);
+
+   // The same state as saveState() (which it goes through, as the state is spread over lots of small units)
+   void hashState(Hasher& hasher);
+
+   // Plain copies of the emulation state, for restoring into the same instance (see GameBoy::Snapshot)
+   void saveSnapshot(SoundControllerState& state);
+   void loadSnapshot(const SoundControllerState& state);
+
+   // Like saving a snapshot of the other controller and loading it, without the copy in between (see GameBoy::fork())
+   void copyStateFrom(SoundController& other);
 
    uint8_t read(uint16_t address) const;
    void write(uint16_t address, uint8_t value);
@@ -717,27 +1052,27 @@ public:
 private:
    friend class FrameSequencer;
 
-   const std::vector<AudioSample>& getAudioData() const
+   const RingBuffer<AudioSample>& getAudioData() const
    {
-      return buffers[activeBufferIndex];
+      return audioBuffer;
    }
 
 #if DM_WITH_UI
-   const std::vector<int8_t>& getSquare1Data() const
+   const RingBuffer<int8_t>& getSquare1Data() const
    {
-      return square1Buffers[activeBufferIndex];
+      return square1Buffer;
    }
-   const std::vector<int8_t>& getSquare2Data() const
+   const RingBuffer<int8_t>& getSquare2Data() const
    {
-      return square2Buffers[activeBufferIndex];
+      return square2Buffer;
    }
-   const std::vector<int8_t>& getWaveData() const
+   const RingBuffer<int8_t>& getWaveData() const
    {
-      return waveBuffers[activeBufferIndex];
+      return waveBuffer;
    }
-   const std::vector<int8_t>& getNoiseData() const
+   const RingBuffer<int8_t>& getNoiseData() const
    {
-      return noiseBuffers[activeBufferIndex];
+      return noiseBuffer;
    }
 #endif // DM_WITH_UI
 
@@ -746,6 +1081,49 @@ private:
    void setPowerEnabled(bool newPowerEnabled);
    void pushSample();
 
+   bool samplesNeeded() const
+   {
+      // Per-channel samples are recorded at the native sample rate regardless of the synthesis mode
+      if (captureChannelData)
+      {
+         return true;
+      }
+
+#if DM_WITH_UI
+      if (generateChannelData)
+      {
+         return true;
+      }
+#endif // DM_WITH_UI
+
+      return synthesisMode == SynthesisMode::PointSampled;
+   }
+
+   bool isGeneratingOutput() const
+   {
+      return generateData && !outputSuspended;
+   }
+
+   void advance(uint32_t numMachineCycles);
+   void advanceChannels(uint32_t cycles);
+   uint32_t cyclesUntilChannelClock() const;
+   void scheduleNextEvent();
+
+   void addBandLimitedDeltas();
+   void flushBandLimitedSamples();
+   void resetBandLimitedSynthesis();
+
+   bool isResampling() const
+   {
+      return outputSampleRate != kSampleRate;
+   }
+
+   void flushPendingOutput();
+   void mixPendingSamples();
+   void flushResampledSamples();
+   void captureOutput();
+   void resizeAudioBuffer();
+
    void lengthClock()
    {
       squareWaveChannel1.lengthClock();
@@ -766,25 +1144,40 @@ private:
       squareWaveChannel1.sweepClock();
    }
 
-   FrameSequencer frameSequencer;
-   Mixer mixer;
-   bool powerEnabled = false;
+   MixBlock mixBlock;
 
-   SquareWaveChannel squareWaveChannel1;
-   SquareWaveChannel squareWaveChannel2;
-   WaveChannel waveChannel;
-   NoiseChannel noiseChannel;
+   uint32_t pendingMachineCycles = 0;
+   uint32_t machineCyclesUntilEvent = 1;
 
    bool generateData = false;
-   uint8_t cyclesSinceLastSample = 0;
-   std::size_t activeBufferIndex = 0;
-   std::array<std::vector<AudioSample>, 2> buffers;
+   bool outputSuspended = false;
+   SynthesisMode synthesisMode = SynthesisMode::PointSampled;
+   uint32_t outputSampleRate = kSampleRate;
+   double audioBufferDuration = 0.0;
+   RingBuffer<AudioSample> audioBuffer;
+   uint64_t audioReadIndex = 0;
+
+   Resampler leftResampler;
+   Resampler rightResampler;
+
+   BandLimitedBuffer leftBandLimitedBuffer;
+   BandLimitedBuffer rightBandLimitedBuffer;
+   AudioSample lastBandLimitedSample;
+   uint32_t bandLimitedFrameCycles = 0;
+   bool outputChanged = false;
+
+   std::unique_ptr<AudioCapture> audioCapture;
+   uint64_t captureReadIndex = 0;
+   bool captureChannelData = false;
+
+   Archive hashArchive;
 
 #if DM_WITH_UI
-   std::array<std::vector<int8_t>, 2> square1Buffers;
-   std::array<std::vector<int8_t>, 2> square2Buffers;
-   std::array<std::vector<int8_t>, 2> waveBuffers;
-   std::array<std::vector<int8_t>, 2> noiseBuffers;
+   bool generateChannelData = false;
+   RingBuffer<int8_t> square1Buffer;
+   RingBuffer<int8_t> square2Buffer;
+   RingBuffer<int8_t> waveBuffer;
+   RingBuffer<int8_t> noiseBuffer;
 #endif // DM_WITH_UI
 };
 
@@ -0,0 +1,73 @@
+#include "GameBoy/WavFile.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace DotMatrix
+{
+
+WavFile::WavFile(const std::filesystem::path& path, uint32_t fileSampleRate, uint16_t fileNumChannels)
+   : stream(path, std::ios::binary)
+   , sampleRate(fileSampleRate)
+   , numChannels(fileNumChannels)
+{
+   writeHeader();
+}
+
+WavFile::~WavFile()
+{
+   if (stream)
+   {
+      stream.seekp(0);
+      writeHeader();
+   }
+}
+
+void WavFile::write(const int16_t* values, std::size_t numValues)
+{
+   bytes.resize(numValues * sizeof(int16_t));
+   for (std::size_t i = 0; i < numValues; ++i)
+   {
+      uint16_t value = static_cast<uint16_t>(values[i]);
+      bytes[i * 2 + 0] = static_cast<char>(value & 0x00FF);
+      bytes[i * 2 + 1] = static_cast<char>(value >> 8);
+   }
+
+   stream.write(bytes.data(), bytes.size());
+   dataSize += bytes.size();
+}
+
+void WavFile::writeValue(uint32_t value, std::size_t numBytes)
+{
+   for (std::size_t i = 0; i < numBytes; ++i)
+   {
+      stream.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+   }
+}
+
+void WavFile::writeHeader()
+{
+   static const uint32_t kHeaderSize = 36;
+
+   // Sizes past what the header can hold are left at the maximum (most readers then just read to the end of the file)
+   uint32_t headerDataSize = static_cast<uint32_t>(std::min<uint64_t>(dataSize, std::numeric_limits<uint32_t>::max() - kHeaderSize));
+   uint32_t bytesPerFrame = numChannels * sizeof(int16_t);
+
+   stream.write("RIFF", 4);
+   writeValue(kHeaderSize + headerDataSize, 4);
+   stream.write("WAVE", 4);
+
+   stream.write("fmt ", 4);
+   writeValue(16, 4);
+   writeValue(1, 2); // PCM
+   writeValue(numChannels, 2);
+   writeValue(sampleRate, 4);
+   writeValue(sampleRate * bytesPerFrame, 4);
+   writeValue(bytesPerFrame, 2);
+   writeValue(16, 2);
+
+   stream.write("data", 4);
+   writeValue(headerDataSize, 4);
+}
+
+} // namespace DotMatrix
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace DotMatrix
+{
+
+// 16 bit PCM WAV file, written as it goes, with the sizes in the header filled in when it is closed
+class WavFile
+{
+public:
+   WavFile(const std::filesystem::path& path, uint32_t fileSampleRate, uint16_t fileNumChannels);
+   ~WavFile();
+
+   WavFile(const WavFile& other) = delete;
+   WavFile& operator=(const WavFile& other) = delete;
+
+   bool isOpen() const
+   {
+      return stream.good();
+   }
+
+   // Values are interleaved by channel
+   void write(const int16_t* values, std::size_t numValues);
+
+   // Frames (one value per channel) written so far
+   uint64_t getNumFrames() const
+   {
+      return dataSize / (numChannels * sizeof(int16_t));
+   }
+
+private:
+   void writeValue(uint32_t value, std::size_t numBytes);
+   void writeHeader();
+
+   std::ofstream stream;
+   std::vector<char> bytes;
+   uint32_t sampleRate = 0;
+   uint16_t numChannels = 0;
+   uint64_t dataSize = 0;
+};
+
+} // namespace DotMatrix
@@ -9,8 +9,14 @@
 #include <AL/alc.h>
 #include <boxer/boxer.h>
 
+#include <algorithm>
+#include <chrono>
+
 namespace
 {
+   // Samples that can be written ahead of playback before the stream overflows
+   const std::size_t kStreamSamples = 16384;
+
 #if DM_DEBUG
    const char* alErrorString(ALenum error)
    {
@@ -94,6 +100,7 @@ namespace
 
 AudioManager::AudioManager()
    : device(alcOpenDevice(nullptr), deleteDevice)
+   , stream(kStreamSamples)
 {
    checkAlcError(device.get(), "opening device");
 
@@ -119,6 +126,15 @@ AudioManager::AudioManager()
    }
    checkAlcError(device.get(), "making audio context current");
 
+   // Generate samples at the rate the device mixes at, so they don't have to be resampled again
+   ALCint frequency = 0;
+   alcGetIntegerv(device.get(), ALC_FREQUENCY, 1, &frequency);
+   checkAlcError(device.get(), "querying device frequency");
+   if (frequency > 0)
+   {
+      sampleRate = static_cast<uint32_t>(frequency);
+   }
+
    alGenSources(1, &source);
    checkAlError("generating audio source");
 
@@ -132,13 +148,75 @@ AudioManager::AudioManager()
    alSourcei(source, AL_LOOPING, AL_FALSE);
    checkAlError("disabling source looping");
 
+   setBufferConfiguration(kDefaultNumBuffers, kDefaultSamplesPerBuffer);
+}
+
+AudioManager::~AudioManager()
+{
+   stopAudioThread();
+
+   if (alIsSource(source))
+   {
+      alDeleteSources(1, &source);
+      checkAlError("deleting source");
+
+      alDeleteBuffers(static_cast<ALsizei>(buffers.size()), buffers.data());
+      checkAlError("deleting buffers");
+   }
+
+   alcMakeContextCurrent(nullptr);
+   checkAlcError(device.get(), "making no context current");
+
+   // Destroy in order
+   context = nullptr;
+   device = nullptr;
+}
+
+std::size_t AudioManager::write(const DotMatrix::AudioSample* samples, std::size_t numSamples)
+{
+   if (!isValid())
+   {
+      return 0;
+   }
+
+   return stream.tryPush(samples, numSamples);
+}
+
+void AudioManager::setBufferConfiguration(std::size_t numBuffers, std::size_t newSamplesPerBuffer)
+{
+   DM_ASSERT(numBuffers >= 2 && newSamplesPerBuffer > 0);
+
+   if (!isValid() || (numBuffers == getNumBuffers() && newSamplesPerBuffer == samplesPerBuffer))
+   {
+      return;
+   }
+
+   stopAudioThread();
+
+   alSourceStop(source);
+   checkAlError("stopping source");
+
+   if (!buffers.empty())
+   {
+      // Detaching the buffer unqueues everything (allowed since the source is stopped)
+      alSourcei(source, AL_BUFFER, 0);
+      checkAlError("unqueueing all buffers");
+
+      alDeleteBuffers(static_cast<ALsizei>(buffers.size()), buffers.data());
+      checkAlError("deleting buffers");
+   }
+
+   buffers.assign(numBuffers, 0);
+   samplesPerBuffer = newSamplesPerBuffer;
+   bufferData.resize(samplesPerBuffer);
+
    alGenBuffers(static_cast<ALsizei>(buffers.size()), buffers.data());
    checkAlError("generating buffers");
 
    DotMatrix::AudioSample silenceSample;
    for (ALuint buffer : buffers)
    {
-      alBufferData(buffer, AL_FORMAT_STEREO16, &silenceSample, static_cast<ALsizei>(sizeof(DotMatrix::AudioSample)), static_cast<ALsizei>(DotMatrix::SoundController::kSampleRate));
+      alBufferData(buffer, AL_FORMAT_STEREO16, &silenceSample, static_cast<ALsizei>(sizeof(DotMatrix::AudioSample)), static_cast<ALsizei>(sampleRate));
       checkAlError("setting buffer data");
    }
 
@@ -147,56 +225,125 @@ AudioManager::AudioManager()
 
    alSourcePlay(source);
    checkAlError("playing source");
+
+   startAudioThread();
 }
 
-AudioManager::~AudioManager()
+double AudioManager::getLatencyMs() const
 {
-   if (alIsSource(source))
+   if (!isValid())
    {
-      alDeleteSources(1, &source);
-      checkAlError("deleting source");
+      return 0.0;
+   }
 
-      alDeleteBuffers(static_cast<ALsizei>(buffers.size()), buffers.data());
-      checkAlError("deleting buffers");
+   return (getQueuedSamples() * 1000.0) / sampleRate;
+}
+
+double AudioManager::getFillLevel() const
+{
+   if (!isValid())
+   {
+      return 0.5;
    }
 
-   alcMakeContextCurrent(nullptr);
-   checkAlcError(device.get(), "making no context current");
+   // Ideally every OpenAL buffer is queued and the stream is close to empty
+   const std::size_t targetQueuedSamples = getNumBuffers() * samplesPerBuffer;
 
-   // Destroy in order
-   context = nullptr;
-   device = nullptr;
+   return std::min(getQueuedSamples() / (2.0 * targetQueuedSamples), 1.0);
 }
 
-bool AudioManager::canQueue() const
+void AudioManager::setPitch(float pitch)
 {
-   if (!isValid())
+   alSourcef(source, AL_PITCH, pitch);
+   checkAlError("setting source pitch");
+}
+
+void AudioManager::startAudioThread()
+{
+   exiting = false;
+   audioThread = std::thread([this]()
    {
-      return false;
+      audioThreadMain();
+   });
+}
+
+void AudioManager::stopAudioThread()
+{
+   exiting = true;
+   if (audioThread.joinable())
+   {
+      audioThread.join();
    }
+}
+
+void AudioManager::audioThreadMain()
+{
+   // OpenAL has no way to wait for a buffer to finish, so poll a few times per buffer's worth of playback
+   const std::chrono::microseconds pollInterval((samplesPerBuffer * 1000000) / (sampleRate * 4));
+
+   while (!exiting)
+   {
+      while (refillBuffer())
+      {
+      }
+
+      std::this_thread::sleep_for(pollInterval);
+   }
+}
+
+std::size_t AudioManager::getQueuedSamples() const
+{
+   ALint numQueued = 0;
+   alGetSourcei(source, AL_BUFFERS_QUEUED, &numQueued);
+   checkAlError("querying number of buffers queued");
 
    ALint numProcessed = 0;
    alGetSourcei(source, AL_BUFFERS_PROCESSED, &numProcessed);
    checkAlError("querying number of buffers processed");
 
-   return numProcessed > 0;
+   // Measured from the start of the first queued buffer, including any that have been processed but not yet unqueued
+   ALint sampleOffset = 0;
+   alGetSourcei(source, AL_SAMPLE_OFFSET, &sampleOffset);
+   checkAlError("querying source sample offset");
+
+   std::size_t numUnplayedBuffers = static_cast<std::size_t>(std::max(numQueued - numProcessed, 0));
+   std::size_t numPlayedSamples = static_cast<std::size_t>(std::max(sampleOffset - numProcessed * static_cast<ALint>(samplesPerBuffer), 0));
+   std::size_t numSourceSamples = numUnplayedBuffers * samplesPerBuffer;
+
+   return stream.size() + (numSourceSamples - std::min(numPlayedSamples, numSourceSamples));
 }
 
-void AudioManager::queue(const std::vector<DotMatrix::AudioSample>& audioData)
+bool AudioManager::refillBuffer()
 {
-   DM_ASSERT(!audioData.empty());
-   DM_ASSERT(canQueue());
+   // Only queue whole buffers, so that running dry leaves a gap instead of a stream of tiny buffers that keep starving
+   if (stream.size() < samplesPerBuffer)
+   {
+      return false;
+   }
+
+   ALint numProcessed = 0;
+   alGetSourcei(source, AL_BUFFERS_PROCESSED, &numProcessed);
+   checkAlError("querying number of buffers processed");
+
+   if (numProcessed <= 0)
+   {
+      return false;
+   }
+
+   std::size_t numSamples = stream.tryPop(bufferData.data(), samplesPerBuffer);
+   DM_ASSERT(numSamples == samplesPerBuffer);
 
    ALuint buffer = 0;
    alSourceUnqueueBuffers(source, 1, &buffer);
    checkAlError("unqueueing buffer");
 
-   alBufferData(buffer, AL_FORMAT_STEREO16, audioData.data(), static_cast<ALsizei>(audioData.size() * sizeof(DotMatrix::AudioSample)), static_cast<ALsizei>(DotMatrix::SoundController::kSampleRate));
+   alBufferData(buffer, AL_FORMAT_STEREO16, bufferData.data(), static_cast<ALsizei>(numSamples * sizeof(DotMatrix::AudioSample)), static_cast<ALsizei>(sampleRate));
    checkAlError("setting buffer data");
 
    alSourceQueueBuffers(source, 1, &buffer);
    checkAlError("queueing buffer");
 
+   // The source stops once it plays every queued buffer, so restart it if the stream ran dry
    ALint state = 0;
    alGetSourcei(source, AL_SOURCE_STATE, &state);
    checkAlError("getting source state");
@@ -206,10 +353,6 @@ void AudioManager::queue(const std::vector<DotMatrix::AudioSample>& audioData)
       alSourcePlay(source);
       checkAlError("playing source");
    }
-}
 
-void AudioManager::setPitch(float pitch)
-{
-   alSourcef(source, AL_PITCH, pitch);
-   checkAlError("setting source pitch");
+   return true;
 }
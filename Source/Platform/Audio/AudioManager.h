@@ -4,12 +4,15 @@
 #   error "Including AudioManager header, but DM_WITH_AUDIO is not set!"
 #endif // !DM_WITH_AUDIO
 
+#include "Core/SPSCQueue.h"
+
 #include "GameBoy/SoundController.h"
 
-#include <array>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <thread>
 #include <vector>
 
 struct ALCcontext;
@@ -19,6 +22,13 @@ typedef unsigned int ALuint;
 class AudioManager
 {
 public:
+   static const std::size_t kDefaultNumBuffers = 3;
+   static const std::size_t kDefaultSamplesPerBuffer = 1024;
+
+   // Small buffers are refilled as soon as each one finishes, so little audio has to be queued ahead of playback
+   static const std::size_t kLowLatencyNumBuffers = 4;
+   static const std::size_t kLowLatencySamplesPerBuffer = 256;
+
    AudioManager();
    ~AudioManager();
 
@@ -27,14 +37,70 @@ public:
       return device.get() != nullptr && context.get() != nullptr;
    }
 
-   bool canQueue() const;
-   void queue(const std::vector<DotMatrix::AudioSample>& audioData);
+   // Native sample rate of the device (falls back to the sound controller's rate if it can't be determined)
+   uint32_t getSampleRate() const
+   {
+      return sampleRate;
+   }
+
+   // Adds samples to the stream played by the audio thread, and returns the number accepted (any that don't fit are
+   // dropped). Only to be called from one thread at a time.
+   std::size_t write(const DotMatrix::AudioSample* samples, std::size_t numSamples);
+
+   std::size_t getNumBuffers() const
+   {
+      return buffers.size();
+   }
+
+   std::size_t getSamplesPerBuffer() const
+   {
+      return samplesPerBuffer;
+   }
+
+   // Replaces the OpenAL buffers (briefly stopping playback). Audio waiting in the stream is kept.
+   void setBufferConfiguration(std::size_t numBuffers, std::size_t newSamplesPerBuffer);
+
+   bool isLowLatency() const
+   {
+      return getNumBuffers() == kLowLatencyNumBuffers && getSamplesPerBuffer() == kLowLatencySamplesPerBuffer;
+   }
+
+   void setLowLatency(bool lowLatency)
+   {
+      if (lowLatency)
+      {
+         setBufferConfiguration(kLowLatencyNumBuffers, kLowLatencySamplesPerBuffer);
+      }
+      else
+      {
+         setBufferConfiguration(kDefaultNumBuffers, kDefaultSamplesPerBuffer);
+      }
+   }
+
+   // Time until a sample written now is played (not counting any latency added by the device itself)
+   double getLatencyMs() const;
+
+   // How much audio is waiting to be played, relative to twice the target amount (so 0.5 is right on target)
+   double getFillLevel() const;
 
    void setPitch(float pitch);
 
 private:
+   void startAudioThread();
+   void stopAudioThread();
+   void audioThreadMain();
+   std::size_t getQueuedSamples() const;
+   bool refillBuffer();
+
    std::unique_ptr<ALCdevice, std::function<void(ALCdevice*)>> device;
    std::unique_ptr<ALCcontext, std::function<void(ALCcontext*)>> context;
+   uint32_t sampleRate = DotMatrix::SoundController::kSampleRate;
    ALuint source = 0;
-   std::array<ALuint, 3> buffers = {};
+   std::vector<ALuint> buffers;
+   std::size_t samplesPerBuffer = 0;
+
+   DotMatrix::SPSCQueue<DotMatrix::AudioSample> stream;
+   std::vector<DotMatrix::AudioSample> bufferData;
+   std::thread audioThread;
+   std::atomic_bool exiting = false;
 };
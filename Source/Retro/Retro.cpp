@@ -1,16 +1,18 @@
+#include "Core/Archive.h"
 #include "Core/Assert.h"
 
 #include "GameBoy/Cartridge.h"
 #include "GameBoy/CPU.h"
 #include "GameBoy/GameBoy.h"
 #include "GameBoy/LCDController.h"
+#include "GameBoy/RomImage.h"
 #include "GameBoy/SoundController.h"
 
 #include <libretro.h>
 
 #include <array>
 #include <cstdint>
-#include <cstring>
+#include <cstdlib>
 #include <memory>
 #include <string>
 #include <vector>
@@ -20,6 +22,11 @@ namespace
    static const double kClockCyclesPerFrame = 70224.0;
    static const double kFrameRate = DotMatrix::CPU::kClockSpeed / kClockCyclesPerFrame;
 
+   // A rate that frontends can usually pass straight through to the audio device
+   static const uint32_t kSampleRate = 48000;
+
+   static const char* kRunAheadVariable = "dotmatrix_run_ahead";
+
    struct Pixel
    {
       uint8_t b;
@@ -51,9 +58,17 @@ namespace
    {
       std::unique_ptr<DotMatrix::GameBoy> gameBoy;
       std::unique_ptr<PixelArray> pixels;
+      std::vector<DotMatrix::AudioSample> audioData;
 
-      uint32_t frameCounter = 0;
       double frameTime = 0.0;
+
+      // Frames emulated past the one being played (with the same input), the last of which is shown in its place. This
+      // hides as many frames of the game's own input latency.
+      uint32_t runAheadFrames = 0;
+      DotMatrix::GameBoy::Snapshot runAheadSnapshot;
+
+      // Savestates are a fixed size for the loaded game, which frontends rely on
+      std::size_t stateSize = 0;
    }
 
    void frameTimeCallback(retro_usec_t usec)
@@ -81,6 +96,82 @@ namespace
       }
    }
 
+   void readOptions()
+   {
+      struct retro_variable variable;
+      variable.key = kRunAheadVariable;
+      variable.value = nullptr;
+
+      if (Callbacks::environment && Callbacks::environment(RETRO_ENVIRONMENT_GET_VARIABLE, &variable) && variable.value)
+      {
+         State::runAheadFrames = static_cast<uint32_t>(std::strtoul(variable.value, nullptr, 10));
+      }
+   }
+
+   std::shared_ptr<const DotMatrix::RomImage> loadRomImage(const struct retro_game_info* game)
+   {
+      if (!game)
+      {
+         return nullptr;
+      }
+
+      // Frontends pass paths as UTF-8, which is what the image expects
+      if (game->path)
+      {
+         if (std::shared_ptr<const DotMatrix::RomImage> romImage = DotMatrix::RomImage::fromFile(game->path))
+         {
+            return romImage;
+         }
+      }
+
+      // Content that doesn't come from a file (or one that can't be mapped) still gets loaded if the frontend read it in
+      if (game->data && game->size > 0)
+      {
+         const uint8_t* data = static_cast<const uint8_t*>(game->data);
+         return DotMatrix::RomImage::fromData(std::vector<uint8_t>(data, data + game->size));
+      }
+
+      return nullptr;
+   }
+
+   // Whether the frontend is going to use the video and audio of the coming frame (it might not be, when it runs ahead
+   // itself or fast forwards)
+   void getAudioVideoEnable(bool& videoEnabled, bool& audioEnabled)
+   {
+      int flags = 0;
+      if (Callbacks::environment && Callbacks::environment(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &flags))
+      {
+         videoEnabled = (flags & 0x01) != 0;
+         audioEnabled = audioEnabled && (flags & 0x02) != 0;
+      }
+   }
+
+   // Emulates one frame's worth of time, returning whether a new frame was finished. Frames that aren't rendered are
+   // never scanned, and no samples are generated for frames that aren't heard.
+   bool runFrame(bool render, bool generateAudio)
+   {
+      DotMatrix::LCDController& lcdController = State::gameBoy->getLCDController();
+      DotMatrix::SoundController& soundController = State::gameBoy->getSoundController();
+
+      lcdController.setRenderingEnabled(render);
+      soundController.setOutputSuspended(!generateAudio);
+
+      uint32_t frameCounter = lcdController.getFrameCounter();
+      State::gameBoy->tick(State::frameTime);
+
+      if (generateAudio)
+      {
+         State::audioData.resize(soundController.getAudioBufferCapacity());
+         std::size_t numSamples = soundController.readAudioData(State::audioData.data(), State::audioData.size());
+         if (Callbacks::audioSampleBatch && numSamples > 0)
+         {
+            Callbacks::audioSampleBatch(&State::audioData[0].left, numSamples);
+         }
+      }
+
+      return lcdController.getFrameCounter() != frameCounter;
+   }
+
    void updatePixelsAndRefreshVideo()
    {
       if (State::gameBoy && State::pixels)
@@ -98,6 +189,17 @@ namespace
 void retro_set_environment(retro_environment_t callback)
 {
    Callbacks::environment = callback;
+
+   static const struct retro_variable kVariables[] =
+   {
+      { kRunAheadVariable, "Run-ahead frames; 0|1|2|3|4" },
+      { nullptr, nullptr }
+   };
+
+   if (Callbacks::environment)
+   {
+      Callbacks::environment(RETRO_ENVIRONMENT_SET_VARIABLES, const_cast<struct retro_variable*>(kVariables));
+   }
 }
 
 void retro_set_video_refresh(retro_video_refresh_t callback)
@@ -128,7 +230,6 @@ void retro_init(void)
 {
    State::pixels = std::make_unique<PixelArray>();
 
-   State::frameCounter = 0;
    State::frameTime = 0.0;
 }
 
@@ -136,7 +237,6 @@ void retro_deinit(void)
 {
    State::pixels = nullptr;
 
-   State::frameCounter = 0;
    State::frameTime = 0.0;
 }
 
@@ -152,7 +252,9 @@ void retro_get_system_info(struct retro_system_info* info)
       info->library_name = DM_PROJECT_DISPLAY_NAME;
       info->library_version = DM_VERSION_STRING;
       info->valid_extensions = "";
-      info->need_fullpath = false;
+      // The ROM is mapped from its file rather than having the frontend read it into memory (which would then have to be
+      // copied, as the frontend's buffer isn't guaranteed to outlive the call to retro_load_game())
+      info->need_fullpath = true;
       info->block_extract = false;
    }
 }
@@ -168,7 +270,7 @@ void retro_get_system_av_info(struct retro_system_av_info* info)
       info->geometry.aspect_ratio = static_cast<float>(DotMatrix::kScreenWidth) / DotMatrix::kScreenHeight;
 
       info->timing.fps = kFrameRate;
-      info->timing.sample_rate = DotMatrix::SoundController::kSampleRate;
+      info->timing.sample_rate = kSampleRate;
    }
 }
 
@@ -179,7 +281,10 @@ void retro_set_controller_port_device(unsigned port, unsigned device)
 
 void retro_reset(void)
 {
-   // TODO
+   if (State::gameBoy)
+   {
+      State::gameBoy->reset();
+   }
 }
 
 void retro_run(void)
@@ -207,36 +312,80 @@ void retro_run(void)
 
       State::gameBoy->getSoundController().setGenerateAudioData(Callbacks::audioSampleBatch != nullptr);
 
-      State::gameBoy->tick(State::frameTime);
-
-      const std::vector<DotMatrix::AudioSample>& audioData = State::gameBoy->getSoundController().swapAudioBuffers();
-      if (Callbacks::audioSampleBatch && !audioData.empty())
+      bool optionsUpdated = false;
+      if (Callbacks::environment && Callbacks::environment(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &optionsUpdated) && optionsUpdated)
       {
-         Callbacks::audioSampleBatch(&audioData[0].left, audioData.size());
+         readOptions();
       }
 
-      uint32_t newFrameCounter = State::gameBoy->getLCDController().getFrameCounter();
-      if (State::frameCounter != newFrameCounter)
+      bool videoEnabled = true;
+      bool audioEnabled = Callbacks::audioSampleBatch != nullptr;
+      getAudioVideoEnable(videoEnabled, audioEnabled);
+
+      if (State::runAheadFrames == 0 || !videoEnabled)
       {
-         updatePixelsAndRefreshVideo();
+         if (runFrame(videoEnabled, audioEnabled) && videoEnabled)
+         {
+            updatePixelsAndRefreshVideo();
+         }
+      }
+      else
+      {
+         // The frame being played is heard but not seen. Frames are then emulated ahead (silently, and only the last one
+         // is drawn) to be shown in its place, after which the machine goes back to where the frame being played left it.
+         runFrame(false, audioEnabled);
+         State::gameBoy->saveSnapshot(State::runAheadSnapshot);
+
+         bool frameFinished = false;
+         for (uint32_t i = 1; i <= State::runAheadFrames; ++i)
+         {
+            frameFinished = runFrame(i == State::runAheadFrames, false);
+         }
+
+         if (frameFinished)
+         {
+            updatePixelsAndRefreshVideo();
+         }
+
+         State::gameBoy->loadSnapshot(State::runAheadSnapshot);
       }
-      State::frameCounter = newFrameCounter;
    }
 }
 
 size_t retro_serialize_size(void)
 {
-   return 0;
+   return State::stateSize;
 }
 
 bool retro_serialize(void* data, size_t size)
 {
-   return false;
+   if (!State::gameBoy || !data)
+   {
+      return false;
+   }
+
+   if (size < State::stateSize)
+   {
+      return false;
+   }
+
+   // Written straight into the frontend's buffer
+   DotMatrix::Archive state(static_cast<uint8_t*>(data), size);
+   State::gameBoy->saveState(state);
+   DM_ASSERT(state.getSize() == State::stateSize);
+
+   return !state.hasOverflowed();
 }
 
 bool retro_unserialize(const void* data, size_t size)
 {
-   return false;
+   if (!State::gameBoy || !data || size < State::stateSize)
+   {
+      return false;
+   }
+
+   DotMatrix::ArchiveView state(static_cast<const uint8_t*>(data), size);
+   return State::gameBoy->loadState(state);
 }
 
 void retro_cheat_reset(void)
@@ -267,16 +416,19 @@ bool retro_load_game(const struct retro_game_info* game)
       return false;
    }
 
-   if (game && game->data && game->size > 0)
+   std::shared_ptr<const DotMatrix::RomImage> romImage = loadRomImage(game);
+   if (romImage && romImage->size() > 0)
    {
-      std::vector<uint8_t> data(game->size);
-      std::memcpy(data.data(), game->data, game->size);
-
       std::string error;
-      if (std::unique_ptr<DotMatrix::Cartridge> cartridge = DotMatrix::Cartridge::fromData(std::move(data), error))
+      if (std::unique_ptr<DotMatrix::Cartridge> cartridge = DotMatrix::Cartridge::fromImage(std::move(romImage), error))
       {
          State::gameBoy = std::make_unique<DotMatrix::GameBoy>();
          State::gameBoy->setCartridge(std::move(cartridge));
+         State::gameBoy->getSoundController().setSynthesisMode(DotMatrix::SynthesisMode::BandLimited);
+         State::gameBoy->getSoundController().setOutputSampleRate(kSampleRate);
+         State::stateSize = State::gameBoy->saveState().getSize();
+
+         readOptions();
 
          updatePixelsAndRefreshVideo();
 
@@ -295,6 +447,7 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info* i
 void retro_unload_game(void)
 {
    State::gameBoy = nullptr;
+   State::stateSize = 0;
 }
 
 unsigned retro_get_region(void)
@@ -3,9 +3,14 @@
 #define private public
 #include "GameBoy/Cartridge.h"
 #include "GameBoy/GameBoy.h"
+#include "GameBoy/GBS.h"
+#include "GameBoy/RomImage.h"
+#include "GameBoy/SoundController.h"
 #undef private
 #undef _ALLOW_KEYWORD_MACROS
 
+#include "GameBoy/WavFile.h"
+
 #include <PlatformUtils/IOUtils.h>
 #include <readerwriterqueue.h>
 
@@ -146,9 +151,9 @@ namespace
          TestResult& result = data.testResults[i];
 
          std::string error;
-         if (std::optional<std::vector<uint8_t>> cartData = IOUtils::readBinaryFile(result.cartPath))
+         if (std::shared_ptr<const DotMatrix::RomImage> romImage = DotMatrix::RomImage::fromFile(result.cartPath.u8string()))
          {
-            if (std::unique_ptr<DotMatrix::Cartridge> cartridge = DotMatrix::Cartridge::fromData(std::move(*cartData), error))
+            if (std::unique_ptr<DotMatrix::Cartridge> cartridge = DotMatrix::Cartridge::fromImage(std::move(romImage), error))
             {
                static const std::string kMooneye = "mooneye";
 
@@ -280,10 +285,10 @@ namespace
 
    void runProfileInPath(std::filesystem::path path, float time)
    {
-      if (std::optional<std::vector<uint8_t>> cartData = IOUtils::readBinaryFile(path))
+      if (std::shared_ptr<const DotMatrix::RomImage> romImage = DotMatrix::RomImage::fromFile(path.u8string()))
       {
          std::string error;
-         if (std::unique_ptr<DotMatrix::Cartridge> cartridge = DotMatrix::Cartridge::fromData(std::move(*cartData), error))
+         if (std::unique_ptr<DotMatrix::Cartridge> cartridge = DotMatrix::Cartridge::fromImage(std::move(romImage), error))
          {
             std::unique_ptr<DotMatrix::GameBoy> gameBoy = std::make_unique<DotMatrix::GameBoy>();
             gameBoy->setCartridge(std::move(cartridge));
@@ -297,6 +302,79 @@ namespace
          }
       }
    }
+
+   // Renders a song from a GBS file to a WAV file as fast as possible
+   void runGBSInPath(std::filesystem::path path, int songNumber, float time, std::filesystem::path wavPath)
+   {
+      static const double kClockCyclesPerFrame = 70224.0;
+      static const uint32_t kSampleRate = 44100;
+
+      std::optional<std::vector<uint8_t>> gbsData = IOUtils::readBinaryFile(path);
+      if (!gbsData)
+      {
+         std::printf("Unable to read %s\n", path.generic_string().c_str());
+         return;
+      }
+
+      std::string error;
+      std::unique_ptr<DotMatrix::GBS> gbs = DotMatrix::GBS::fromData(std::move(*gbsData), error);
+      if (!gbs)
+      {
+         std::printf("Unable to load %s (%s)\n", path.generic_string().c_str(), error.c_str());
+         return;
+      }
+
+      // Song numbers on the command line start at 1, like in most players
+      uint8_t song = songNumber > 0 ? static_cast<uint8_t>(songNumber - 1) : gbs->getFirstSong();
+      std::unique_ptr<DotMatrix::Cartridge> cartridge = gbs->createCartridge(song, error);
+      if (!cartridge)
+      {
+         std::printf("Unable to load song %d (%s)\n", song + 1, error.c_str());
+         return;
+      }
+
+      DotMatrix::WavFile wavFile(wavPath, kSampleRate, 2);
+      if (!wavFile.isOpen())
+      {
+         std::printf("Unable to open %s\n", wavPath.generic_string().c_str());
+         return;
+      }
+
+      std::printf("%s - %s (%s), song %d of %d\n", gbs->getTitle().c_str(), gbs->getAuthor().c_str(), gbs->getCopyright().c_str(), song + 1, gbs->getNumSongs());
+
+      std::unique_ptr<DotMatrix::GameBoy> gameBoy = std::make_unique<DotMatrix::GameBoy>();
+      gameBoy->setCartridge(std::move(cartridge));
+
+      DotMatrix::SoundController& soundController = gameBoy->getSoundController();
+      soundController.setGenerateAudioData(true);
+      soundController.setSynthesisMode(DotMatrix::SynthesisMode::BandLimited);
+      soundController.setOutputSampleRate(kSampleRate);
+
+      std::vector<DotMatrix::AudioSample> audioData(soundController.getAudioBufferCapacity());
+
+      double frameTime = kClockCyclesPerFrame / DotMatrix::CPU::kClockSpeed;
+      uint64_t numFrames = static_cast<uint64_t>(time / frameTime);
+
+      auto start = std::chrono::high_resolution_clock::now();
+      for (uint64_t frame = 0; frame < numFrames; ++frame)
+      {
+         // The LCD is off, so VBlank never fires on its own
+         if (!gbs->usesTimer())
+         {
+            gameBoy->requestInterrupt(DotMatrix::Interrupt::VBlank);
+         }
+
+         gameBoy->tick(frameTime);
+
+         std::size_t numSamples = soundController.readAudioData(audioData.data(), audioData.size());
+         wavFile.write(&audioData[0].left, numSamples * 2);
+      }
+      auto end = std::chrono::high_resolution_clock::now();
+
+      std::chrono::duration<double> elapsedSeconds = end - start;
+      double audioSeconds = static_cast<double>(wavFile.getNumFrames()) / kSampleRate;
+      std::printf("Rendered %f seconds of audio in %f seconds (%.1fx realtime)\n", audioSeconds, elapsedSeconds.count(), audioSeconds / elapsedSeconds.count());
+   }
 }
 
 int main(int argc, char *argv[])
@@ -366,8 +444,44 @@ int main(int argc, char *argv[])
          runProfileInPath(pathArg, time);
          return 0;
       }
+      else if (type == "-gbs")
+      {
+         static const float kDefaultSongTime = 180.0f;
+         float time = kDefaultSongTime;
+         int songNumber = 0;
+
+         if (argc > 3)
+         {
+            std::stringstream ss(argv[3]);
+            int parsedSongNumber = 0;
+            if (ss >> parsedSongNumber)
+            {
+               songNumber = parsedSongNumber;
+            }
+         }
+
+         if (argc > 4)
+         {
+            std::stringstream ss(argv[4]);
+            float parsedTime = 0.0f;
+            if (ss >> parsedTime)
+            {
+               time = parsedTime;
+            }
+         }
+
+         std::filesystem::path wavPath = pathArg;
+         wavPath.replace_extension(".wav");
+         if (argc > 5)
+         {
+            wavPath = argv[5];
+         }
+
+         runGBSInPath(pathArg, songNumber, time, wavPath);
+         return 0;
+      }
    }
 
-   std::printf("Usage: %s {-test {suite_name|tests_dir} [test_time] | -profile cart_path [profile_time]}\n", argv[0]);
+   std::printf("Usage: %s {-test {suite_name|tests_dir} [test_time] | -profile cart_path [profile_time] | -gbs gbs_path [song_number] [song_time] [wav_path]}\n", argv[0]);
    return 0;
 }
@@ -364,6 +364,62 @@ namespace
 
       ImGui::PopID();
    }
+
+   template<std::size_t kNumBanks>
+   struct RamBankHelper
+   {
+      RamBanks<kNumBanks>* ramBanks = nullptr;
+      std::size_t bankIndex = 0;
+   };
+
+   template<std::size_t kNumBanks>
+   ImU8 readRamBank(const ImU8* data, std::size_t offset)
+   {
+      const RamBankHelper<kNumBanks>* ramBankHelper = reinterpret_cast<const RamBankHelper<kNumBanks>*>(data);
+
+      return (*ramBankHelper->ramBanks)[ramBankHelper->bankIndex][offset];
+   }
+
+   template<std::size_t kNumBanks>
+   void writeRamBank(ImU8* data, std::size_t offset, ImU8 value)
+   {
+      RamBankHelper<kNumBanks>* ramBankHelper = reinterpret_cast<RamBankHelper<kNumBanks>*>(data);
+
+      ramBankHelper->ramBanks->write(ramBankHelper->bankIndex, static_cast<uint16_t>(offset), value);
+   }
+
+   template<std::size_t kNumBanks>
+   MemoryEditor createRamBankEditor()
+   {
+      MemoryEditor memoryEditor;
+
+      memoryEditor.ReadFn = readRamBank<kNumBanks>;
+      memoryEditor.WriteFn = writeRamBank<kNumBanks>;
+
+      return memoryEditor;
+   }
+
+   // Banks aren't laid out one after the other (any of them can be shared with forked cartridges), so they're shown one
+   // at a time. Only edits go through write(), so just looking at a bank leaves it shared and its hash intact.
+   template<std::size_t kNumBanks>
+   void renderRamBanks(RamBanks<kNumBanks>& ramBanks, std::size_t ramSize)
+   {
+      static int bankIndex = 0;
+
+      int numBanks = static_cast<int>(std::min(ramSize / sizeof(RamBank), kNumBanks));
+      if (numBanks > 1)
+      {
+         ImGui::SliderInt("Bank", &bankIndex, 0, numBanks - 1);
+      }
+      bankIndex = std::min(bankIndex, std::max(numBanks - 1, 0));
+
+      RamBankHelper<kNumBanks> ramBankHelper;
+      ramBankHelper.ramBanks = &ramBanks;
+      ramBankHelper.bankIndex = static_cast<std::size_t>(bankIndex);
+
+      static MemoryEditor memoryEditor = createRamBankEditor<kNumBanks>();
+      memoryEditor.DrawContents(&ramBankHelper, std::min(ramSize, sizeof(RamBank)));
+   }
 }
 
 void UI::renderCartridgeWindow(Cartridge* cart) const
@@ -453,7 +509,7 @@ void UI::renderCartridgeWindow(Cartridge* cart) const
 
       if (ImGui::BeginTabItem("Memory Bank Controller"))
       {
-         std::size_t maxRomBank = std::max(cart->cartData.size() / 16384, static_cast<std::size_t>(1)) - 1;
+         std::size_t maxRomBank = std::max(cart->romSize / 16384, static_cast<std::size_t>(1)) - 1;
          std::size_t ramSize = getRAMSizeBytes(header.ramSize);
          std::size_t maxRamBank = std::max(ramSize / 8192, static_cast<std::size_t>(1)) - 1;
 
@@ -521,7 +577,10 @@ void UI::renderCartridgeWindow(Cartridge* cart) const
 
       if (ImGui::BeginTabItem("ROM"))
       {
-         memoryEditor.DrawContents(cart->cartData.data(), cart->cartData.size());
+         // The ROM image can be shared with other cartridges, so it is never written to
+         static MemoryEditor romEditor;
+         romEditor.ReadOnly = true;
+         romEditor.DrawContents(const_cast<uint8_t*>(cart->romData), cart->romSize);
 
          ImGui::EndTabItem();
       }
@@ -534,8 +593,7 @@ void UI::renderCartridgeWindow(Cartridge* cart) const
          }
          else if (MBC1* mbc1 = dynamic_cast<MBC1*>(mbc))
          {
-            std::size_t ramSize = std::min(getRAMSizeBytes(header.ramSize), mbc1->ramBanks[0].size() * mbc1->ramBanks.size());
-            memoryEditor.DrawContents(mbc1->ramBanks[0].data(), ramSize);
+            renderRamBanks(mbc1->ramBanks, getRAMSizeBytes(header.ramSize));
          }
          else if (MBC2* mbc2 = dynamic_cast<MBC2*>(mbc))
          {
@@ -544,13 +602,11 @@ void UI::renderCartridgeWindow(Cartridge* cart) const
          }
          else if (MBC3* mbc3 = dynamic_cast<MBC3*>(mbc))
          {
-            std::size_t ramSize = std::min(getRAMSizeBytes(header.ramSize), mbc3->ramBanks[0].size() * mbc3->ramBanks.size());
-            memoryEditor.DrawContents(mbc3->ramBanks[0].data(), ramSize);
+            renderRamBanks(mbc3->ramBanks, getRAMSizeBytes(header.ramSize));
          }
          else if (MBC5* mbc5 = dynamic_cast<MBC5*>(mbc))
          {
-            std::size_t ramSize = std::min(getRAMSizeBytes(header.ramSize), mbc5->ramBanks[0].size() * mbc5->ramBanks.size());
-            memoryEditor.DrawContents(mbc5->ramBanks[0].data(), ramSize);
+            renderRamBanks(mbc5->ramBanks, getRAMSizeBytes(header.ramSize));
          }
          else
          {
@@ -13,7 +13,7 @@ namespace DotMatrix
 void UI::renderEmulatorWindow(Emulator& emulator) const
 {
    ImGui::SetNextWindowPos(ImVec2(580.0f, 559.0f), ImGuiCond_FirstUseEver);
-   ImGui::SetNextWindowSize(ImVec2(290.0f, 90.0f), ImGuiCond_FirstUseEver);
+   ImGui::SetNextWindowSize(ImVec2(290.0f, 130.0f), ImGuiCond_FirstUseEver);
    ImGui::Begin("Emulator");
 
    float timeScale = static_cast<float>(emulator.timeScale);
@@ -26,6 +26,23 @@ void UI::renderEmulatorWindow(Emulator& emulator) const
    uint64_t totalCycles = emulator.gameBoy ? emulator.gameBoy->totalCycles : 0;
    ImGui::Text("Total cycles: %llu", totalCycles);
 
+#if DM_WITH_AUDIO
+   AudioManager& audioManager = emulator.audioManager;
+   if (audioManager.isValid())
+   {
+      ImGui::Separator();
+
+      bool lowLatency = audioManager.isLowLatency();
+      if (ImGui::Checkbox("Low latency audio", &lowLatency))
+      {
+         audioManager.setLowLatency(lowLatency);
+      }
+
+      ImGui::Text("Audio buffers: %zu x %zu", audioManager.getNumBuffers(), audioManager.getSamplesPerBuffer());
+      ImGui::Text("Audio latency: %.1f ms", audioManager.getLatencyMs());
+   }
+#endif // DM_WITH_AUDIO
+
    ImGui::End();
 }
 
@@ -6,6 +6,7 @@
 #include "UI/AfterCoreIncludes.inl"
 
 #include <imgui.h>
+#include <PlatformUtils/IOUtils.h>
 
 #include <cmath>
 #include <limits>
@@ -26,9 +27,20 @@ namespace
       return (*floatSamples)[index];
    }
 
-   void updateSamples(std::vector<float>& samples, int& offset, const std::vector<int8_t>& audioData)
+   template<typename T>
+   const std::vector<T>& readNewData(const RingBuffer<T>& buffer, uint64_t& readIndex)
    {
-      for (int8_t audioSample : audioData)
+      static std::vector<T> data;
+
+      data.resize(buffer.capacity());
+      data.resize(buffer.read(readIndex, data.data(), data.size()));
+
+      return data;
+   }
+
+   void updateSamples(std::vector<float>& samples, int& offset, const RingBuffer<int8_t>& buffer, uint64_t& readIndex)
+   {
+      for (int8_t audioSample : readNewData(buffer, readIndex))
       {
          samples[offset] = static_cast<float>(audioSample);
          offset = (offset + 1) % kNumPlottedSamples;
@@ -61,7 +73,18 @@ void UI::renderSoundControllerWindow(SoundController& soundController) const
 {
    ImGui::SetNextWindowPos(ImVec2(5.0f, 322.0f), ImGuiCond_FirstUseEver);
    ImGui::SetNextWindowSize(ImVec2(570.0f, 451.0f), ImGuiCond_FirstUseEver);
-   ImGui::Begin("Sound Controller");
+   bool visible = ImGui::Begin("Sound Controller");
+
+   // Per-channel samples keep the sound controller stepping at its native rate, so only generate them while they can be seen
+   soundController.setGenerateChannelData(visible);
+   if (!visible)
+   {
+      ImGui::End();
+      return;
+   }
+
+   // Show (and edit) the channels as of the current machine cycle
+   soundController.catchUp();
 
    if (ImGui::CollapsingHeader("Output", ImGuiTreeNodeFlags_DefaultOpen))
    {
@@ -72,12 +95,48 @@ void UI::renderSoundControllerWindow(SoundController& soundController) const
          soundController.write(0xFF26, powerEnabled ? 0x80 : 0x00);
       }
 
+      static bool captureChannels = false;
+      static std::string captureError;
+      bool capturing = soundController.isCapturingAudio();
+      if (ImGui::Checkbox("Capture to WAV", &capturing))
+      {
+         captureError.clear();
+
+         if (capturing)
+         {
+            std::optional<std::filesystem::path> capturePath = IOUtils::getAbsoluteAppDataPath(DM_PROJECT_NAME, "capture.wav");
+            if (!capturePath)
+            {
+               captureError = "Unable to find the app data directory";
+            }
+            else if (!soundController.startAudioCapture(capturePath->string(), captureChannels, captureError))
+            {
+               captureError = "Unable to capture audio (" + captureError + ")";
+            }
+         }
+         else
+         {
+            soundController.stopAudioCapture();
+         }
+      }
+      ImGui::SameLine();
+      ImGui::Checkbox("Include channels", &captureChannels);
+
+      if (soundController.isCapturingAudio())
+      {
+         ImGui::Text("Dropped samples: %llu", static_cast<unsigned long long>(soundController.getNumDroppedCaptureSamples()));
+      }
+      else if (!captureError.empty())
+      {
+         ImGui::Text("%s", captureError.c_str());
+      }
+
       static std::vector<float> leftSamples(kNumPlottedSamples);
       static std::vector<float> rightSamples(kNumPlottedSamples);
       static int offset = 0;
+      static uint64_t readIndex = 0;
 
-      const std::vector<AudioSample>& audioData = soundController.getAudioData();
-      for (const AudioSample& audioSample : audioData)
+      for (const AudioSample& audioSample : readNewData(soundController.getAudioData(), readIndex))
       {
          leftSamples[offset] = static_cast<float>(audioSample.left);
          rightSamples[offset] = static_cast<float>(audioSample.right);
@@ -127,7 +186,8 @@ void UI::renderSoundControllerWindow(SoundController& soundController) const
 
       static std::vector<float> samples(kNumPlottedSamples);
       static int offset = 0;
-      updateSamples(samples, offset, soundController.getSquare1Data());
+      static uint64_t readIndex = 0;
+      updateSamples(samples, offset, soundController.getSquare1Data(), readIndex);
 
       renderSoundChannel(squareWaveChannel1, samples, offset);
       renderSoundTimer(squareWaveChannel1.timer, kWaveMaxPeriod, true);
@@ -147,7 +207,8 @@ void UI::renderSoundControllerWindow(SoundController& soundController) const
 
       static std::vector<float> samples(kNumPlottedSamples);
       static int offset = 0;
-      updateSamples(samples, offset, soundController.getSquare2Data());
+      static uint64_t readIndex = 0;
+      updateSamples(samples, offset, soundController.getSquare2Data(), readIndex);
 
       renderSoundChannel(squareWaveChannel2, samples, offset);
       renderSoundTimer(squareWaveChannel2.timer, kWaveMaxPeriod, true);
@@ -166,7 +227,8 @@ void UI::renderSoundControllerWindow(SoundController& soundController) const
 
       static std::vector<float> samples(kNumPlottedSamples);
       static int offset = 0;
-      updateSamples(samples, offset, soundController.getWaveData());
+      static uint64_t readIndex = 0;
+      updateSamples(samples, offset, soundController.getWaveData(), readIndex);
 
       renderSoundChannel(waveChannel, samples, offset);
       renderSoundTimer(waveChannel.timer, kWaveMaxPeriod, true);
@@ -186,7 +248,8 @@ void UI::renderSoundControllerWindow(SoundController& soundController) const
 
       static std::vector<float> samples(kNumPlottedSamples);
       static int offset = 0;
-      updateSamples(samples, offset, soundController.getNoiseData());
+      static uint64_t readIndex = 0;
+      updateSamples(samples, offset, soundController.getNoiseData(), readIndex);
 
       renderSoundChannel(noiseChannel, samples, offset);
       renderSoundTimer(noiseChannel.timer, kMaxNoisePeriod, false);
@@ -213,8 +276,7 @@ void UI::renderSoundChannel(SoundChannel& soundChannel, std::vector<float>& samp
    }
 }
 
-template<typename T>
-void UI::renderSoundTimer(SoundTimer<T>& soundTimer, uint32_t maxPeriod, bool displayNote) const
+void UI::renderSoundTimer(SoundTimer& soundTimer, uint32_t maxPeriod, bool displayNote) const
 {
    if (ImGui::TreeNode("Timer"))
    {
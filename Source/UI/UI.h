@@ -24,10 +24,9 @@ class LengthUnit;
 class LFSRUnit;
 class SoundChannel;
 class SoundController;
+class SoundTimer;
 class SweepUnit;
 class WaveUnit;
-template<typename T>
-class SoundTimer;
 struct Joypad;
 
 class UI
@@ -60,8 +59,7 @@ private:
 #endif // DM_WITH_DEBUGGER
 
    void renderSoundChannel(SoundChannel& soundChannel, std::vector<float>& samples, int offset) const;
-   template<typename T>
-   void renderSoundTimer(SoundTimer<T>& soundTimer, uint32_t maxPeriod, bool displayNote) const;
+   void renderSoundTimer(SoundTimer& soundTimer, uint32_t maxPeriod, bool displayNote) const;
    void renderDutyUnit(DutyUnit& dutyUnit) const;
    void renderLengthUnit(LengthUnit& lengthUnit) const;
    void renderEnvelopeUnit(EnvelopeUnit& envelopeUnit) const;